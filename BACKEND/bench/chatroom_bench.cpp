@@ -0,0 +1,316 @@
+// 后端热路径微基准
+// 用法：chatroom_bench [--filter=子串] [--min-time=秒] [--repetitions=N] [--output=文件]
+// 结果以JSON输出（默认stdout），便于对比不同提交的回归。
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+#include "database/database_manager.h"
+#include "handlers/binary_codec.h"
+#include "handlers/inbound_json.h"
+#include "handlers/outbound_frame.h"
+#include "models/message.h"
+#include "models/user.h"
+#include "services/auth_service.h"
+#include "services/message_filter.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+struct Options {
+    std::string filter;
+    double min_time = 0.5;   // 每次重复的最短运行时间（秒）
+    int repetitions = 5;
+    std::string output;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations = 0;  // 每次重复的迭代次数
+    std::vector<double> ns_per_op;
+};
+
+// 阻止编译器把基准中的计算优化掉
+template <typename T>
+void keep(const T& value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+using Clock = std::chrono::steady_clock;
+
+double run_batch(const std::function<void()>& op, uint64_t iterations) {
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        op();
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+class Runner {
+public:
+    explicit Runner(const Options& options) : options(options) {}
+
+    void add(const std::string& name, std::function<void()> op) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+            return;
+        }
+
+        // 预热并校准迭代次数，使每次重复约运行min_time秒
+        uint64_t iterations = 1;
+        double elapsed = run_batch(op, iterations);
+        while (elapsed < options.min_time / 10 && iterations < (uint64_t(1) << 40)) {
+            iterations *= 2;
+            elapsed = run_batch(op, iterations);
+        }
+        iterations = std::max<uint64_t>(1, static_cast<uint64_t>(iterations * options.min_time / std::max(elapsed, 1e-9)));
+
+        Result result;
+        result.name = name;
+        result.iterations = iterations;
+        for (int i = 0; i < options.repetitions; ++i) {
+            double seconds = run_batch(op, iterations);
+            result.ns_per_op.push_back(seconds * 1e9 / static_cast<double>(iterations));
+        }
+
+        std::sort(result.ns_per_op.begin(), result.ns_per_op.end());
+        std::cerr << name << ": " << result.ns_per_op[result.ns_per_op.size() / 2] << " ns/op" << std::endl;
+        results.push_back(std::move(result));
+    }
+
+    json report() const {
+        json benchmarks = json::array();
+        for (const auto& result : results) {
+            double median = result.ns_per_op[result.ns_per_op.size() / 2];
+            benchmarks.push_back({
+                {"name", result.name},
+                {"iterations", result.iterations},
+                {"repetitions", result.ns_per_op.size()},
+                {"ns_per_op_median", median},
+                {"ns_per_op_min", result.ns_per_op.front()},
+                {"ns_per_op_max", result.ns_per_op.back()},
+                {"ops_per_second", median > 0 ? 1e9 / median : 0}
+            });
+        }
+
+#ifdef NDEBUG
+        const char* build_type = "release";
+#else
+        const char* build_type = "debug";
+#endif
+        return {
+            {"context", {
+                {"timestamp", static_cast<int64_t>(std::time(nullptr))},
+                {"num_cpus", std::thread::hardware_concurrency()},
+                {"build_type", build_type},
+#ifdef __VERSION__
+                {"compiler", __VERSION__},
+#endif
+                {"min_time", options.min_time}
+            }},
+            {"benchmarks", benchmarks}
+        };
+    }
+
+private:
+    const Options& options;
+    std::vector<Result> results;
+};
+
+Message sample_message(int id) {
+    Message message(id, 1, "Hello everyone, this is a fairly typical chat message with some words in it.");
+    message.sender_username = "bench_user";
+    return message;
+}
+
+json message_frame(const Message& message) {
+    // 与WebSocketHandler广播聊天消息时构建的帧相同
+    return {
+        {"type", "message"},
+        {"message", {
+            {"id", message.id},
+            {"sender_id", message.sender_id},
+            {"sender_username", message.sender_username},
+            {"content", message.content},
+            {"timestamp", message.timestamp},
+            {"type", Message::type_to_string(message.type)},
+            {"room", message.room_id}
+        }}
+    };
+}
+
+void bench_filter(Runner& runner) {
+    MessageFilter filter;
+    // 显式加入命中样本用到的词，结果不依赖运行目录下是否有词库文件
+    for (const char* word : {"idiot", "stupid", "shit", "垃圾", "废物", "白痴"}) {
+        filter.add_sensitive_word(word);
+    }
+
+    auto repeat_to = [](const std::string& text, size_t size) {
+        std::string out;
+        while (out.size() < size) out += text + " ";
+        return out;
+    };
+
+    std::string clean = "Hello everyone, this is a fairly typical chat message with some words in it.";
+    std::string hits = "You idiot, that was a stupid idea and the result is shit, stupid idiot.";
+    std::string cjk_clean = "大家好，今天的会议改到下午三点，请提前准备好材料。";
+    std::string cjk_hits = "你这个白痴，写的代码全是垃圾，真是个废物。";
+    std::string long_clean = repeat_to(clean, 4096);
+    std::string long_hits = repeat_to(hits, 4096);
+    std::string long_cjk_hits = repeat_to(cjk_hits, 4096);
+
+    runner.add("MessageFilter::filter_message/clean_80B", [&]() { keep(filter.filter_message(clean)); });
+    runner.add("MessageFilter::filter_message/clean_4KB", [&]() { keep(filter.filter_message(long_clean)); });
+    // 命中替换路径
+    runner.add("MessageFilter::filter_message/hits_80B", [&]() { keep(filter.filter_message(hits)); });
+    runner.add("MessageFilter::filter_message/hits_4KB", [&]() { keep(filter.filter_message(long_hits)); });
+    // 中文（多字节UTF-8）
+    runner.add("MessageFilter::filter_message/cjk_clean", [&]() { keep(filter.filter_message(cjk_clean)); });
+    runner.add("MessageFilter::filter_message/cjk_hits", [&]() { keep(filter.filter_message(cjk_hits)); });
+    runner.add("MessageFilter::filter_message/cjk_hits_4KB", [&]() { keep(filter.filter_message(long_cjk_hits)); });
+}
+
+void bench_database(Runner& runner, const std::string& db_path) {
+    auto db = std::make_shared<DatabaseManager>(db_path);
+    if (!db->initialize()) {
+        std::cerr << "Failed to initialize benchmark database at " << db_path << std::endl;
+        return;
+    }
+
+    User user(0, "bench_user", "x", "bench@example.com");
+    db->create_user(user);
+    auto stored = db->get_user_by_username("bench_user");
+    if (!stored) {
+        std::cerr << "Failed to create benchmark user" << std::endl;
+        return;
+    }
+
+    // 基准用户的token
+    AuthService auth(db);
+    std::string token = auth.generate_token(*stored);
+    runner.add("AuthService::validate_token", [&]() { keep(auth.validate_token(token)); });
+    std::string forged = token;
+    forged.back() = forged.back() == 'A' ? 'B' : 'A';
+    runner.add("AuthService::validate_token/invalid_signature", [&]() { keep(auth.validate_token(forged)); });
+
+    Message message = sample_message(0);
+    message.sender_id = stored->id;
+    runner.add("DatabaseManager::save_message", [&]() {
+        message.id = db->reserve_message_id();
+        keep(db->save_message(message));
+    });
+
+    for (int i = 0; i < 200; ++i) {
+        message.id = db->reserve_message_id();
+        db->save_message(message);
+    }
+    runner.add("DatabaseManager::get_recent_messages/50", [&]() {
+        keep(db->get_recent_messages(Message::DEFAULT_ROOM, 50));
+    });
+}
+
+void bench_frames(Runner& runner) {
+    Message message = sample_message(12345);
+    message.timestamp = 1700000000;
+
+    runner.add("WebSocketHandler/build_message_frame", [&]() {
+        keep(OutboundFrame::from_json(message_frame(message)));
+    });
+    runner.add("WebSocketHandler/build_message_frame_binary", [&]() {
+        auto frame = message_frame(message);
+        keep(BinaryCodec::encode(frame, frame.dump()));
+    });
+
+    std::string inbound = R"({"type":"chat","content":"Hello everyone, this is a fairly typical chat message.","room":"general"})";
+    runner.add("WebSocketHandler/decode_inbound_json", [&]() {
+        InboundMessage msg;
+        keep(InboundJson::decode(inbound, msg));
+    });
+    runner.add("WebSocketHandler/decode_inbound_json_dom", [&]() {
+        keep(json::parse(inbound));
+    });
+
+    runner.add("Message::to_json", [&]() { keep(message.to_json()); });
+
+    User user(42, "bench_user", "hash", "bench@example.com", UserStatus::ONLINE);
+    runner.add("User::to_json", [&]() { keep(user.to_json()); });
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* prefix) -> const char* {
+            size_t length = std::char_traits<char>::length(prefix);
+            return arg.compare(0, length, prefix) == 0 ? arg.c_str() + length : nullptr;
+        };
+
+        if (const char* v = value("--filter=")) {
+            options.filter = v;
+        } else if (const char* v = value("--min-time=")) {
+            options.min_time = std::strtod(v, nullptr);
+        } else if (const char* v = value("--repetitions=")) {
+            options.repetitions = std::atoi(v);
+        } else if (const char* v = value("--output=")) {
+            options.output = v;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter=SUBSTR] [--min-time=SECONDS] [--repetitions=N] [--output=FILE]" << std::endl;
+            return false;
+        }
+    }
+    return options.min_time > 0 && options.repetitions > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+
+    // 数据库基准使用临时文件，结束后删除
+    std::string db_path = (std::filesystem::temp_directory_path() /
+                           ("chatroom_bench_" + std::to_string(getpid()) + ".db")).string();
+
+    Runner runner(options);
+    bench_filter(runner);
+    bench_database(runner, db_path);
+    bench_frames(runner);
+
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::error_code ec;
+        std::filesystem::remove(db_path + suffix, ec);
+    }
+
+    std::string report = runner.report().dump(2);
+    if (options.output.empty()) {
+        std::cout << report << std::endl;
+    } else {
+        std::ofstream out(options.output);
+        if (!out) {
+            std::cerr << "Failed to open " << options.output << std::endl;
+            return 1;
+        }
+        out << report << std::endl;
+    }
+    return 0;
+}
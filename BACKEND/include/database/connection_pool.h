@@ -0,0 +1,71 @@
+#pragma once
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "statement_cache.h"
+
+// 池中的单个SQLite连接及其语句缓存
+struct PooledConnection {
+    sqlite3* handle = nullptr;
+    StatementCache statements;
+    
+    ~PooledConnection();
+};
+
+// SQLite连接池（WAL模式）
+// 一个写连接（互斥使用）+ N个只读连接，读操作不会阻塞写入。
+// 每个连接同一时刻只被一个线程持有，因此连接以SQLITE_OPEN_NOMUTEX打开。
+class ConnectionPool {
+public:
+    // 连接租约：析构时归还连接（写连接则释放写锁）
+    class Lease {
+    private:
+        ConnectionPool* pool;
+        PooledConnection* connection;
+        std::unique_lock<std::mutex> writer_lock;
+        
+    public:
+        Lease(ConnectionPool* pool, PooledConnection* connection, std::unique_lock<std::mutex> writer_lock);
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+        
+        sqlite3* handle() const { return connection ? connection->handle : nullptr; }
+        sqlite3_stmt* statement(const std::string& query) const;
+        explicit operator bool() const { return connection && connection->handle; }
+    };
+    
+    // reader_count为0时按CPU核心数创建只读连接
+    ConnectionPool(const std::string& db_path, size_t reader_count = 0);
+    
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+    
+    bool open();
+    bool prepare_statements(const std::vector<std::string>& reader_queries,
+                            const std::vector<std::string>& writer_queries);
+    
+    Lease acquire_reader();
+    Lease acquire_writer();
+    
+    size_t get_reader_count() const { return readers.size(); }
+    
+private:
+    std::string db_path;
+    size_t reader_count;
+    
+    std::unique_ptr<PooledConnection> writer;
+    std::mutex writer_mutex;
+    
+    std::vector<std::unique_ptr<PooledConnection>> readers;
+    std::vector<PooledConnection*> idle_readers;
+    std::mutex readers_mutex;
+    std::condition_variable readers_cv;
+    
+    bool open_connection(PooledConnection& connection, bool read_only);
+    bool apply_pragmas(sqlite3* handle, bool read_only);
+    void release_reader(PooledConnection* connection);
+};
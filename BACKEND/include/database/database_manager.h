@@ -2,17 +2,24 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <atomic>
 #include <sqlite3.h>
+#include "connection_pool.h"
 #include "../models/user.h"
 #include "../models/message.h"
 
 class DatabaseManager {
 private:
-    sqlite3* db;
     std::string db_path;
     
+    // WAL连接池：单写连接 + 多只读连接，每个连接各自缓存预编译语句
+    ConnectionPool pool;
+    
+    // 最近分配的消息ID（所有消息写入都使用预分配的ID）
+    std::atomic<int> last_message_id{0};
+    
 public:
-    DatabaseManager(const std::string& db_path);
+    DatabaseManager(const std::string& db_path, size_t reader_count = 0);
     ~DatabaseManager();
     
     bool initialize();
@@ -24,25 +31,41 @@ public:
     std::unique_ptr<User> get_user_by_id(int user_id);
     bool update_user_status(int user_id, UserStatus status);
     bool update_user_last_seen(int user_id);
+    bool update_user_password_hash(int user_id, const std::string& password_hash);
     std::vector<User> get_online_users();
     
     // 消息相关操作
-    bool save_message(const Message& message);
-    std::vector<Message> get_recent_messages(int limit = 100);
-    std::vector<Message> get_messages_after_timestamp(const std::string& timestamp);
-    std::vector<Message> get_private_messages(int user1_id, int user2_id, int limit = 50);
-    bool delete_message(int message_id, int user_id);
+    int reserve_message_id();
+    bool save_message(Message& message); // 成功后回填消息ID和存储的时间戳
+    bool save_messages(std::vector<Message>& messages); // 单事务批量写入
+    std::vector<Message> get_recent_messages(const std::string& room_id, int limit = 100);
+    // 键集分页（房间内公共消息，按ID升序返回）：after_id > 0时取其后的limit条，否则取before_id之前的limit条；
+    // 游标为0表示不限
+    std::vector<Message> get_messages_page(const std::string& room_id, int after_id, int before_id, int limit);
+    std::vector<Message> get_private_messages(int user1_id, int user2_id, int limit = 50, int before_id = 0);
+    bool delete_message(int message_id, int user_id, std::string* room_id = nullptr); // room_id回填消息所在房间
     bool mark_message_as_read(int message_id, int user_id);
     
     // 用户关系操作
     bool block_user(int user_id, int blocked_user_id);
     bool unblock_user(int user_id, int blocked_user_id);
     std::vector<int> get_blocked_users(int user_id);
+    std::vector<std::pair<int, int>> get_all_blocks(); // 全部(user_id, blocked_user_id)关系，启动时加载
+    
+    // token注销记录（毫秒时间戳，此前签发的token无效）
+    bool save_revocation(int user_id, int64_t revoked_before_ms);
+    std::vector<std::pair<int, int64_t>> get_revocations(int64_t since_ms); // 启动时加载仍在有效期内的记录
+    bool delete_revocations_before(int64_t cutoff_ms);
     
     // 清理过期数据
     bool cleanup_old_messages();
     
 private:
-    bool execute_query(const std::string& query);
+    bool execute_query(sqlite3* handle, const std::string& query);
+    bool prepare_statements();
+    bool migrate_messages_table(sqlite3* handle);
+    bool load_message_id_seed();
+    bool insert_message(const ConnectionPool::Lease& conn, Message& message);
+    static void read_messages(sqlite3_stmt* stmt, std::vector<Message>& messages);
     bool check_table_exists(const std::string& table_name);
 };
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sqlite3.h>
+
+// 预编译语句缓存
+// 每条SQL只调用一次sqlite3_prepare_v2，之后通过reset/重新绑定复用。
+// 缓存属于单个数据库连接，调用方负责保证同一时刻只有一个线程使用该连接。
+class StatementCache {
+private:
+    sqlite3* db;
+    std::unordered_map<std::string, sqlite3_stmt*> statements;
+    
+public:
+    explicit StatementCache(sqlite3* db = nullptr) : db(db) {}
+    ~StatementCache();
+    
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+    
+    void set_database(sqlite3* handle);
+    
+    // 预先编译一组语句
+    bool prepare_all(const std::vector<std::string>& queries);
+    
+    // 获取已缓存的语句，未缓存时按需编译
+    sqlite3_stmt* get(const std::string& query);
+    
+    // 释放所有语句（关闭连接前必须调用）
+    void clear();
+};
+
+// 作用域语句：离开作用域时重置语句并清除绑定，使其可被下一次调用复用
+class ScopedStatement {
+private:
+    sqlite3_stmt* stmt;
+    
+public:
+    explicit ScopedStatement(sqlite3_stmt* stmt) : stmt(stmt) {}
+    ~ScopedStatement();
+    
+    ScopedStatement(const ScopedStatement&) = delete;
+    ScopedStatement& operator=(const ScopedStatement&) = delete;
+    
+    sqlite3_stmt* get() const { return stmt; }
+    explicit operator bool() const { return stmt != nullptr; }
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+#include "inbound_message.h"
+
+// 紧凑二进制WebSocket协议
+// 帧格式：1字节操作码 + 字段序列；整数为无符号LEB128变长编码，字符串为变长长度前缀 + UTF-8字节。
+// 客户端在认证时协商（二进制auth帧或JSON auth帧携带"protocol":"binary"），之后服务器以二进制帧推送，
+// 高频消息使用专用操作码，其余消息封装为JSON信封帧。
+// 协商压缩的连接收到的大帧为OP_DEFLATE二进制帧（JSON与二进制客户端都适用）。
+class BinaryCodec {
+public:
+    enum Opcode : uint8_t {
+        // 客户端 -> 服务器
+        OP_AUTH = 0x01,         // token, [last_message_id], [flags: bit0=deflate]
+        OP_CHAT = 0x02,         // content, [room]
+        OP_PRIVATE = 0x03,      // receiver_id, content
+        OP_STATUS = 0x04,       // status (0=ONLINE, 1=BUSY, 2=OFFLINE)
+        OP_RECALL = 0x05,       // message_id
+        OP_JOIN_ROOM = 0x06,    // room, [last_message_id]
+        OP_LEAVE_ROOM = 0x07,   // room
+
+        // 服务器 -> 客户端
+        OP_MESSAGE = 0x81,          // id, sender_id, timestamp, sender_username, content, room
+        OP_PRIVATE_MESSAGE = 0x82,  // id, sender_id, receiver_id, timestamp, sender_username, content
+        OP_RECALLED = 0x83,         // message_id, room
+        OP_DEFLATE = 0xFE,          // 原始DEFLATE压缩的完整帧（JSON文本或二进制帧）
+        OP_JSON = 0xFF              // JSON文本
+    };
+
+    // 解码入站二进制帧（字符串字段为帧数据的视图），格式错误时返回false
+    static bool decode(const std::string& data, InboundMessage& out);
+
+    // 编码出站帧；text为同一帧已序列化的JSON，用于信封帧
+    static std::string encode(const nlohmann::json& frame, const std::string& text);
+    static std::string encode_envelope(const std::string& text);
+
+    // 基本编码
+    static void put_varint(std::string& out, uint64_t value);
+    static void put_string(std::string& out, const std::string& value);
+    static bool get_varint(const char*& pos, const char* end, uint64_t& value);
+    static bool get_string(const char*& pos, const char* end, std::string_view& value); // 非法UTF-8时返回false
+};
@@ -0,0 +1,166 @@
+#pragma once
+#include <crow.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "outbound_frame.h"
+#include "outbound_queue.h"
+
+// 分片广播引擎
+// 连接按分片分布，每条广播只写入一次共享环形缓冲区，
+// 每个分片由独立线程消费环形缓冲区并推送给自己的连接，
+// 发送方无需等待任何连接的发送完成。
+// 每个连接拥有有界出站队列，慢消费者的帧被合并、丢弃或连接被断开，内存占用有上限。
+// 房间广播只遍历该房间在各分片内的订阅者，扇出成本与房间人数而不是总在线人数相关。
+class BroadcastEngine {
+public:
+    // 升序用户ID列表的不可变快照
+    using UserList = std::shared_ptr<const std::vector<int>>;
+
+    // 单个连接最多同时订阅的房间数（含默认房间）
+    static constexpr size_t MAX_ROOMS_PER_CONNECTION = 64;
+
+    enum class JoinResult {
+        JOINED,          // 已加入（重复加入同一房间也返回JOINED）
+        NOT_REGISTERED,  // 连接未注册
+        INVALID_ROOM,    // 房间名不合法
+        TOO_MANY_ROOMS   // 超过MAX_ROOMS_PER_CONNECTION
+    };
+
+    // shard_count为0时按CPU核心数分片
+    explicit BroadcastEngine(size_t shard_count = 0, size_t ring_capacity = 4096,
+                             OutboundQueue::Limits limits = OutboundQueue::Limits::from_env());
+    ~BroadcastEngine();
+
+    BroadcastEngine(const BroadcastEngine&) = delete;
+    BroadcastEngine& operator=(const BroadcastEngine&) = delete;
+
+    // 连接管理
+    void add_connection(crow::websocket::connection* conn, int user_id);
+    void remove_connection(crow::websocket::connection* conn);
+
+    // 房间订阅；房间最后一个订阅者离开时回收其句柄（leave_room在连接未注册或未加入时返回false）
+    JoinResult join_room(crow::websocket::connection* conn, const std::string& room);
+    bool leave_room(crow::websocket::connection* conn, const std::string& room);
+    bool in_room(crow::websocket::connection* conn, const std::string& room);
+
+    // 设置连接的推送协议：二进制帧或JSON文本帧，以及大帧是否压缩
+    bool set_protocol(crow::websocket::connection* conn, bool binary, bool deflate);
+
+    // 发布广播（O(1)，不触碰任何连接）；room为空时发给所有连接，否则只发给房间订阅者；
+    // skip_users中的用户（如屏蔽了发送者的用户）不接收
+    void publish(SharedFrame payload, int exclude_user_id = -1, const std::string& room = "",
+                 UserList skip_users = nullptr);
+
+    // 经连接的出站队列单独发送；连接未注册时返回false
+    bool send_to(crow::websocket::connection* conn, const SharedFrame& payload);
+
+    // 统计信息
+    size_t get_connection_count() const;
+    size_t get_shard_count() const { return shards.size(); }
+    uint64_t get_dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t get_slow_consumer_drops() const { return slow_consumer_drops.load(std::memory_order_relaxed); }
+    uint64_t get_slow_consumer_disconnects() const { return slow_consumer_disconnects.load(std::memory_order_relaxed); }
+    size_t get_room_count() const;
+    // 所有连接出站队列中的帧数和字节数
+    struct QueueStats {
+        size_t frames = 0;
+        size_t bytes = 0;
+        size_t backlogged_connections = 0;
+    };
+    QueueStats get_queue_stats() const;
+
+private:
+    static constexpr uint64_t SLOT_WRITING = UINT64_MAX;
+    // 存在积压队列时分片线程的重试间隔
+    static constexpr std::chrono::milliseconds BACKLOG_RETRY_INTERVAL{20};
+    // 房间句柄单调递增且不复用，环形缓冲区中尚未分发的旧房间消息不会误投到新房间；
+    // 句柄0表示全体广播
+    using RoomHandle = uint64_t;
+    static constexpr RoomHandle GLOBAL_ROOM = 0;
+
+    struct Slot {
+        std::atomic<uint64_t> sequence{SLOT_WRITING};
+        std::atomic<int> exclude_user_id{-1};
+        std::atomic<RoomHandle> room{GLOBAL_ROOM};
+        std::atomic<int64_t> published_at{0}; // steady_clock纳秒，用于统计分发延迟
+        SharedFrame payload;  // 通过std::atomic_load/atomic_store访问
+        UserList skip_users;  // 同上
+    };
+
+    struct ConnectionState {
+        int user_id;
+        OutboundQueue queue;
+        std::vector<RoomHandle> rooms;
+        bool binary = false;       // 已协商二进制协议
+        bool deflate = false;      // 已协商压缩
+        bool closing = false;      // 已判定为慢消费者，等待分片线程关闭
+        bool close_sent = false;
+        bool scheduled = false;    // 本轮已列入待发送连接
+
+        ConnectionState(int user_id, const OutboundQueue::Limits& limits)
+            : user_id(user_id), queue(limits) {}
+    };
+
+    struct Shard {
+        // 仅用于唤醒分片线程
+        std::mutex wake_mutex;
+        std::condition_variable wake_cv;
+        std::atomic<bool> backlogged{false}; // 有连接的出站队列未清空或待关闭
+
+        // 保护以下成员；发送期间持有，保证连接关闭后不会再被访问
+        mutable std::mutex connections_mutex;
+        std::unordered_map<crow::websocket::connection*, ConnectionState> connections;
+        // 房间 -> 本分片内的订阅者（unordered_map元素地址稳定，可直接保存指针）
+        std::unordered_map<RoomHandle, std::unordered_map<crow::websocket::connection*, ConnectionState*>> room_members;
+        // 出站队列未清空或待关闭的连接
+        std::unordered_set<crow::websocket::connection*> backlog;
+
+        uint64_t cursor = 0;
+        std::thread worker;
+    };
+
+    const OutboundQueue::Limits limits;
+    std::vector<Slot> ring;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> slow_consumer_drops{0};
+    std::atomic<uint64_t> slow_consumer_disconnects{0};
+    std::atomic<bool> running{true};
+
+    // 有订阅者的房间：房间名 -> 句柄和订阅连接数（跨所有分片），订阅数归零时删除
+    // 加锁顺序：shard.connections_mutex之后才能获取rooms_mutex
+    struct RoomEntry {
+        RoomHandle handle;
+        size_t subscribers;
+    };
+    mutable std::mutex rooms_mutex;
+    std::unordered_map<std::string, RoomEntry> room_handles;
+    std::unordered_map<RoomHandle, std::string> room_names;
+    RoomHandle next_room_handle = 1;
+
+    Shard& shard_for(crow::websocket::connection* conn);
+    // 查找房间句柄，房间当前无订阅者时返回GLOBAL_ROOM
+    RoomHandle room_handle(const std::string& room);
+    // 增加/减少房间的订阅数，acquire按需分配句柄，release在订阅数归零时回收
+    RoomHandle acquire_room(const std::string& room);
+    void release_room(RoomHandle handle);
+    void run_shard(Shard& shard);
+    void drain_shard(Shard& shard);
+    void wake(Shard& shard);
+
+    // 以下函数要求调用方持有shard.connections_mutex
+    void remove_locked(Shard& shard, crow::websocket::connection* conn);
+    void enqueue_locked(ConnectionState& state, const SharedFrame& payload);
+    bool flush_locked(crow::websocket::connection* conn, ConnectionState& state,
+                      OutboundQueue::Clock::time_point now);
+};
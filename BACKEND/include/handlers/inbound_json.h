@@ -0,0 +1,16 @@
+#pragma once
+#include <string_view>
+#include "inbound_message.h"
+
+// 入站JSON帧的单遍解码器
+// 只识别固定的入站字段（type、token、content/message、room、receiver_id、status、
+// message_id、last_message_id、protocol、compression），其余字段校验后跳过。
+// 不构建DOM：字符串字段是帧数据的视图，只有含转义的字符串才解码到out.storage。
+class InboundJson {
+public:
+    // 解码JSON文本帧，格式错误、缺少必需字段或type未知时返回false
+    static bool decode(std::string_view data, InboundMessage& out);
+    
+    // 检查字节序列是否为合法UTF-8（与decode对字符串字段的校验相同），二进制协议解码也使用
+    static bool is_valid_utf8(std::string_view text);
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// 入站消息类型（JSON与二进制协议共用）
+enum class InboundType {
+    AUTH,
+    CHAT,
+    PRIVATE,
+    STATUS,
+    RECALL,
+    JOIN_ROOM,
+    LEAVE_ROOM,
+    UNKNOWN
+};
+
+// 解码后的入站消息，只有与type相关的字段有意义
+// 字符串字段直接指向入站帧数据（含转义的JSON字符串解码到storage），
+// 只在帧数据的生命周期内有效；不可复制，避免视图悬空。
+struct InboundMessage {
+    InboundType type = InboundType::UNKNOWN;
+    std::string_view token;
+    std::string_view content;
+    std::string_view room;
+    std::string_view status;
+    int receiver_id = -1;
+    int message_id = 0;
+    int last_message_id = 0;
+    bool binary_protocol = false; // 认证时请求切换到二进制协议
+    bool deflate = false;         // 认证时请求压缩大帧
+
+    // 转义字符串的解码结果（只在遇到转义时分配）
+    std::string storage;
+
+    InboundMessage() = default;
+    InboundMessage(const InboundMessage&) = delete;
+    InboundMessage& operator=(const InboundMessage&) = delete;
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <nlohmann/json.hpp>
+
+// 不可变的出站消息帧
+// 每个事件只序列化一次，通过引用计数在所有接收者之间共享，
+// 广播队列和分片之间传递的都是指针而不是字符串副本。
+// 同时保存JSON文本和二进制协议编码，两种客户端共享同一帧；
+// 压缩副本在首次需要时生成并缓存，每条消息只压缩一次而不是每个接收者一次。
+class OutboundFrame {
+private:
+    std::string payload;
+    std::string binary_payload;
+    // 合并键：出站队列中尚未发出的同键旧帧会被新帧替换（如user_list），空表示不合并
+    std::string coalesce_key;
+    
+    // 压缩副本（延迟生成；不值得压缩时为空）
+    mutable std::once_flag text_deflate_once;
+    mutable std::once_flag binary_deflate_once;
+    mutable std::string deflated_text_payload;
+    mutable std::string deflated_binary_payload;
+    
+public:
+    // 小于该长度的帧压缩收益不足，始终原样发送
+    static constexpr size_t COMPRESSION_THRESHOLD = 512;
+    
+    OutboundFrame(std::string payload, std::string binary_payload, std::string coalesce_key = "")
+        : payload(std::move(payload)), binary_payload(std::move(binary_payload)), 
+          coalesce_key(std::move(coalesce_key)) {}
+    
+    // 构建共享帧
+    static std::shared_ptr<const OutboundFrame> from_json(const nlohmann::json& j,
+                                                          std::string coalesce_key = "");
+    
+    const std::string& text() const { return payload; }
+    const std::string& binary() const { return binary_payload; }
+    
+    // 压缩帧（OP_DEFLATE + 原始DEFLATE数据），为空表示应发送未压缩版本
+    const std::string& deflated_text() const;
+    const std::string& deflated_binary() const;
+    // 按连接协商的协议选择实际发送的数据（压缩副本、二进制编码或JSON文本），
+    // binary_frame回填是否应以WebSocket二进制帧发送
+    const std::string& encoded(bool binary, bool deflate, bool* binary_frame = nullptr) const;
+    size_t size() const { return payload.size(); }
+    const std::string& key() const { return coalesce_key; }
+};
+
+using SharedFrame = std::shared_ptr<const OutboundFrame>;
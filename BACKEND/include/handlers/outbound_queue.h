@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include "outbound_frame.h"
+
+// 单连接的有界出站队列
+// Crow不暴露套接字的待发送字节数和写完成事件，这里用漏桶估算已交给Crow但尚未被客户端读走的字节：
+// 按假定的消费速率持续排空，估算值超过预算时帧暂留在本队列中。两项参数都是估计值，
+// 默认值按普通宽带客户端设定（不限制正常客户端），部署时可按实际网络通过环境变量调整。
+// 字节数按连接协商后实际发送的编码（压缩、二进制或JSON）计算。
+// 队列有条数和字节上限，超限时按策略丢弃最旧的帧或断开慢消费者。
+class OutboundQueue {
+public:
+    enum class SlowConsumerPolicy {
+        DROP_OLDEST,
+        DISCONNECT
+    };
+
+    struct Limits {
+        size_t max_messages = 1024;
+        size_t max_bytes = 4 * 1024 * 1024;
+        size_t max_inflight_bytes = 1024 * 1024;   // 允许交给Crow的未确认字节
+        size_t assumed_drain_rate = 1024 * 1024;   // 假定客户端每秒读走的字节数
+        SlowConsumerPolicy policy = SlowConsumerPolicy::DROP_OLDEST;
+
+        // 从环境变量CHATROOM_SLOW_CONSUMER_POLICY（drop/disconnect）、
+        // CHATROOM_OUTBOUND_MAX_MESSAGES、CHATROOM_OUTBOUND_MAX_BYTES、
+        // CHATROOM_OUTBOUND_MAX_INFLIGHT_BYTES、CHATROOM_OUTBOUND_DRAIN_RATE（字节/秒）读取配置
+        static Limits from_env();
+    };
+
+    enum class PushResult {
+        QUEUED,
+        COALESCED,  // 移除了队列中的同键旧帧，新帧追加在队尾
+        DROPPED,    // 为腾出空间丢弃了旧帧
+        OVERFLOW    // 超限且策略为断开连接，帧未入队
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    explicit OutboundQueue(const Limits& limits);
+
+    PushResult push(SharedFrame frame);
+
+    // 设置连接协商的编码，之后按实际发送的字节数计量
+    void set_encoding(bool binary, bool deflate);
+
+    // 取出下一帧（漏桶预算不足或队列为空时返回nullptr）
+    SharedFrame pop_ready(Clock::time_point now);
+
+    bool empty() const { return frames.empty(); }
+    size_t size() const { return frames.size(); }
+    size_t bytes() const { return queued_bytes; }
+    uint64_t get_dropped_count() const { return dropped; }
+
+private:
+    const Limits& limits;
+    std::deque<SharedFrame> frames;
+    size_t queued_bytes = 0;
+    uint64_t dropped = 0;
+    bool binary = false;
+    bool deflate = false;
+
+    // 漏桶估算的在途字节
+    double inflight_bytes = 0;
+    Clock::time_point last_drain;
+
+    void drop_front();
+    size_t wire_size(const SharedFrame& frame) const;
+};
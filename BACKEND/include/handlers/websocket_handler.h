@@ -1,8 +1,13 @@
 #pragma once
 #include <crow.h>
+#include <nlohmann/json.hpp>
 #include <unordered_map>
 #include <memory>
 #include <mutex>
+#include "broadcast_engine.h"
+#include "inbound_message.h"
+#include "outbound_frame.h"
+#include "../utils/rate_limiter.h"
 
 class ChatService;
 class AuthService;
@@ -14,12 +19,21 @@ private:
         int user_id;
         std::string username;
         std::time_t connected_at;
+        uint64_t ip_key;           // 远端IP的哈希，用于按IP限流
     };
     
     std::unordered_map<crow::websocket::connection*, std::unique_ptr<ClientConnection>> clients;
     std::unordered_map<int, crow::websocket::connection*> user_connections;
     std::mutex clients_mutex;
     
+    // 广播分片引擎（广播不持有clients_mutex）
+    BroadcastEngine broadcast_engine;
+    
+    // 入站帧限流（解析之前执行）：已认证连接按用户，未认证连接按远端IP；
+    // IP默认值（突发2000、每秒200）按校园NAT后上千客户端同时重连并发送auth帧估算
+    RateLimiter user_limiter;
+    RateLimiter ip_limiter;
+    
     std::shared_ptr<ChatService> chat_service;
     std::shared_ptr<AuthService> auth_service;
     
@@ -33,22 +47,38 @@ public:
     void on_message(crow::websocket::connection& conn, const std::string& data, bool is_binary);
     
     // 消息广播
-    void broadcast_message(const std::string& message, int exclude_user_id = -1);
-    void send_to_user(int user_id, const std::string& message);
-    void send_to_connection(crow::websocket::connection* conn, const std::string& message);
+    // room为空时广播给所有连接，否则只发给房间订阅者
+    void broadcast_message(const SharedFrame& frame, int exclude_user_id = -1, const std::string& room = "",
+                           BroadcastEngine::UserList skip_users = nullptr);
+    void send_to_user(int user_id, const SharedFrame& frame);
+    void send_to_connection(crow::websocket::connection* conn, const SharedFrame& frame);
     
     // 连接管理
-    bool authenticate_connection(crow::websocket::connection& conn, const std::string& token);
+    bool authenticate_connection(crow::websocket::connection& conn, const std::string& token,
+                                 int last_message_id = 0, bool binary_protocol = false,
+                                 bool deflate = false);
     void disconnect_user(int user_id);
     std::vector<std::string> get_connected_users();
+    uint64_t get_rate_limited_count() const;
+    const BroadcastEngine& get_broadcast_engine() const { return broadcast_engine; }
     
 private:
-    void handle_chat_message(crow::websocket::connection& conn, const std::string& message);
-    void handle_private_message(crow::websocket::connection& conn, const std::string& message);
+    // 入站解码（JSON或二进制）后统一分发；字符串字段在此处才复制为各服务持有的std::string
+    void dispatch_message(crow::websocket::connection& conn, const InboundMessage& msg);
+    bool admit_message(crow::websocket::connection& conn);
+    
+    void handle_chat_message(crow::websocket::connection& conn, const std::string& message, const std::string& room);
+    void handle_join_room(crow::websocket::connection& conn, const std::string& room, int last_message_id);
+    void handle_leave_room(crow::websocket::connection& conn, const std::string& room);
+    void send_room_error(crow::websocket::connection& conn, const std::string& room, const std::string& message);
+    void handle_private_message(crow::websocket::connection& conn, int receiver_id, const std::string& content);
     void handle_status_change(crow::websocket::connection& conn, const std::string& status);
     void handle_recall_message(crow::websocket::connection& conn, int message_id);
+    void send_history_delta(crow::websocket::connection& conn, int user_id, const std::string& room, int last_message_id);
+    void broadcast_presence(int user_id, const nlohmann::json& delta);
     
-    std::string create_message_json(const std::string& type, const std::string& content, 
-                                   const std::string& sender = "", int message_id = 0);
+    bool get_authenticated_client(crow::websocket::connection& conn, ClientConnection& client);
     void cleanup_connection(crow::websocket::connection& conn);
+    // 释放用户的一个在线连接（连接关闭或切换身份），最后一个连接释放时广播离开
+    void release_user(int user_id, const std::string& username);
 };
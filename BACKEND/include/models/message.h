@@ -10,6 +10,9 @@ enum class MessageType {
 
 class Message {
 public:
+    // 未指定房间的公共消息属于默认房间
+    static constexpr const char* DEFAULT_ROOM = "general";
+    
     int id;
     int sender_id;
     int receiver_id; // -1 for public messages
@@ -18,15 +21,16 @@ public:
     std::time_t timestamp;
     bool is_deleted;
     std::string sender_username;
+    std::string room_id;
     
     Message() : id(0), sender_id(0), receiver_id(-1), type(MessageType::PUBLIC), 
-                timestamp(0), is_deleted(false) {}
+                timestamp(0), is_deleted(false), room_id(DEFAULT_ROOM) {}
     
     Message(int id, int sender_id, const std::string& content, 
             MessageType type = MessageType::PUBLIC, int receiver_id = -1)
         : id(id), sender_id(sender_id), receiver_id(receiver_id), 
           content(content), type(type), timestamp(std::time(nullptr)), 
-          is_deleted(false) {}
+          is_deleted(false), room_id(DEFAULT_ROOM) {}
     
     // JSON序列化
     std::string to_json() const;
@@ -35,6 +39,7 @@ public:
     // 消息验证
     bool is_valid() const;
     bool can_be_recalled() const; // 检查是否在2分钟内可撤回
+    static bool is_valid_room_name(const std::string& room_id); // 1-32位字母、数字、下划线或连字符
     
     // 类型转换
     static std::string type_to_string(MessageType type);
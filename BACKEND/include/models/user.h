@@ -30,9 +30,11 @@ public:
     std::string to_json() const;
     static User from_json(const std::string& json);
     
-    // 密码验证
+    // 密码验证（scrypt，每个用户独立盐值；兼容旧格式哈希）
     bool verify_password(const std::string& password) const;
+    static bool verify_password_hash(const std::string& password, const std::string& password_hash);
     static std::string hash_password(const std::string& password);
+    static bool needs_rehash(const std::string& password_hash);
     
     // 状态转换
     static std::string status_to_string(UserStatus status);
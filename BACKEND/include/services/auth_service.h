@@ -1,35 +1,59 @@
 #pragma once
 #include <string>
 #include <memory>
+#include <atomic>
+#include <functional>
 #include "../models/user.h"
+#include "revocation_list.h"
+#include "token_signer.h"
 
 class DatabaseManager;
+class PasswordHasher;
 
 class AuthService {
 private:
     std::shared_ptr<DatabaseManager> db;
     
+    // 签名token自包含用户信息，验证不访问数据库
+    TokenSigner signer;
+    RevocationList revocations;
+    
+    // 单调递增的签发时间戳（毫秒），保证注销之后签发的token一定晚于注销记录
+    std::atomic<int64_t> last_issue_stamp{0};
+    
+    static constexpr std::time_t TOKEN_TTL_SECONDS = 86400; // 24小时
+    
+    // 密码哈希线程池（请求线程不等待哈希结果）。
+    // 最后声明、最先析构：析构时执行完剩余任务，任务回调仍会访问上面的成员
+    std::shared_ptr<PasswordHasher> hasher;
+    
 public:
     AuthService(std::shared_ptr<DatabaseManager> database);
     
+    // 注册与登录是异步的：密码哈希在哈希线程池中执行，done在哈希线程上调用；
+    // 输入校验失败或哈希队列已满时，done在调用线程上立即调用。done不得抛出异常。
+    
     // 用户注册
     struct RegisterResult {
         bool success;
         std::string message;
         std::unique_ptr<User> user;
     };
-    RegisterResult register_user(const std::string& username, 
-                                const std::string& password, 
-                                const std::string& email);
+    using RegisterCallback = std::function<void(RegisterResult)>;
+    void register_user(const std::string& username, 
+                       const std::string& password, 
+                       const std::string& email,
+                       RegisterCallback done);
     
-    // 用户登录
+    // 用户登录（旧格式哈希的升级在后台进行，不计入登录延迟）
     struct LoginResult {
         bool success;
         std::string message;
         std::unique_ptr<User> user;
         std::string token;
     };
-    LoginResult login_user(const std::string& username, const std::string& password);
+    using LoginCallback = std::function<void(LoginResult)>;
+    void login_user(const std::string& username, const std::string& password, LoginCallback done);
     
     // 用户注销
     bool logout_user(int user_id);
@@ -42,15 +66,19 @@ public:
     };
     TokenValidationResult validate_token(const std::string& token);
     
-    // 生成JWT Token
+    // 生成HMAC签名Token
     std::string generate_token(const User& user);
     
     // 更新用户状态
     bool update_user_status(int user_id, UserStatus status);
     
+    // 清理过期的注销记录（内存与数据库，由后台任务定期调用）
+    size_t evict_expired_sessions();
+    
 private:
     bool is_username_available(const std::string& username);
     bool is_email_available(const std::string& email);
     bool validate_email(const std::string& email);
     bool validate_password(const std::string& password);
+    int64_t next_issue_stamp();
 };
@@ -0,0 +1,44 @@
+#pragma once
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 用户屏蔽关系图
+// 启动时从数据库整体加载，之后随屏蔽/取消屏蔽增量更新，查询不访问数据库。
+// 每个用户保存两个升序列表：自己屏蔽的用户（历史记录过滤）和屏蔽了自己的用户（广播扇出过滤）。
+// 列表写时复制，读者取得快照后无需持锁即可二分查找。
+class BlockGraph {
+public:
+    // 升序用户ID列表的不可变快照（无屏蔽关系时为nullptr）
+    using UserList = std::shared_ptr<const std::vector<int>>;
+
+    // 用(user_id, blocked_user_id)关系整体替换当前内容
+    void load(const std::vector<std::pair<int, int>>& blocks);
+
+    // 返回true表示关系发生了变化
+    bool block(int user_id, int blocked_user_id);
+    bool unblock(int user_id, int blocked_user_id);
+
+    bool is_blocked(int user_id, int other_user_id) const;
+    // user_id屏蔽的用户
+    UserList blocked_by(int user_id) const;
+    // 屏蔽了user_id的用户
+    UserList blockers_of(int user_id) const;
+
+    size_t size() const;
+
+    static bool contains(const UserList& list, int user_id);
+
+private:
+    std::unordered_map<int, UserList> blocked;
+    std::unordered_map<int, UserList> blockers;
+    size_t edge_count = 0;
+    mutable std::shared_mutex mutex;
+
+    static UserList find(const std::unordered_map<int, UserList>& lists, int user_id);
+    // 复制列表并插入/删除一个ID，列表不变时返回false
+    static bool insert(std::unordered_map<int, UserList>& lists, int user_id, int value);
+    static bool erase(std::unordered_map<int, UserList>& lists, int user_id, int value);
+};
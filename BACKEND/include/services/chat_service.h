@@ -1,23 +1,53 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <vector>
 #include <memory>
+#include <shared_mutex>
+#include <unordered_map>
 #include <unordered_set>
-#include <mutex>
 #include "../models/message.h"
 #include "../models/user.h"
+#include "block_graph.h"
+#include "presence_tracker.h"
+#include "recent_message_ring.h"
 
 class DatabaseManager;
 class MessageFilter;
+class MessageWriter;
 
 class ChatService {
 private:
     std::shared_ptr<DatabaseManager> db;
     std::shared_ptr<MessageFilter> filter;
-    std::mutex users_mutex;
-    std::unordered_set<int> online_users;
+    std::shared_ptr<MessageWriter> writer;
+    
+    // 在线用户及其状态（内存维护，不再逐个查询数据库）
+    PresenceTracker presence;
+    
+    // 屏蔽关系（内存维护，历史过滤和广播扇出不访问数据库）
+    BlockGraph blocks;
+    
+    // 各房间的最近公共消息（历史记录的内存缓存，按需创建并预热）
+    // 缓存房间数达到上限时淘汰最久未使用的房间（默认房间除外），被淘汰的房间再次使用时从数据库重新预热
+    struct RoomHistory {
+        std::shared_ptr<RecentMessageRing> ring;
+        std::atomic<int64_t> last_used{0}; // steady_clock计数，共享锁下更新
+    };
+    std::shared_mutex rooms_mutex;
+    std::unordered_map<std::string, RoomHistory> room_histories;
+    static constexpr size_t MAX_CACHED_ROOMS = 256;
+    
+    // 房间内按ID顺序提交：分配ID、入写队列、写入缓冲区和发布在同一把锁内完成，
+    // 保证同一房间内较大ID的消息不会先于较小ID被读到或广播（按房间名哈希分段加锁）
+    static constexpr size_t ROOM_LOCK_STRIPES = 64;
+    std::array<std::mutex, ROOM_LOCK_STRIPES> room_locks;
     
 public:
     ChatService(std::shared_ptr<DatabaseManager> database);
+    ~ChatService();
     
     // 消息处理
     struct SendMessageResult {
@@ -25,30 +55,60 @@ public:
         std::string message;
         std::unique_ptr<Message> processed_message;
     };
+    // on_committed在消息提交后、仍持有房间锁时调用（用于发布广播），必须快速返回
+    using CommitCallback = std::function<void(const Message&)>;
     SendMessageResult send_message(int sender_id, const std::string& content, 
                                   MessageType type = MessageType::PUBLIC, 
-                                  int receiver_id = -1);
+                                  int receiver_id = -1,
+                                  const std::string& sender_username = "",
+                                  const std::string& room_id = Message::DEFAULT_ROOM,
+                                  const CommitCallback& on_committed = nullptr);
     
-    // 消息撤回
-    bool recall_message(int message_id, int user_id);
+    // 消息撤回（room_id回填被撤回消息所在的房间）
+    bool recall_message(int message_id, int user_id, std::string* room_id = nullptr);
     
     // 获取消息历史
+    struct HistoryPage {
+        std::vector<Message> messages; // 按ID升序，已过滤被屏蔽用户
+        bool has_more = false;         // 翻页方向上是否还有更多消息
+        int first_id = 0;              // 本页游标范围（过滤前），用于请求相邻页
+        int last_id = 0;
+    };
+    static constexpr int MAX_HISTORY_PAGE = 200;
+    static constexpr int MAX_CATCH_UP_MESSAGES = 1000;
+    
+    // 键集分页（房间内）：after_id > 0时向新消息方向翻页，否则取before_id之前的消息；游标为0表示不限
+    HistoryPage get_chat_history_page(int user_id, const std::string& room_id, 
+                                      int after_id, int before_id, int limit = 100);
     std::vector<Message> get_chat_history(int user_id, int limit = 100);
-    std::vector<Message> get_private_chat_history(int user1_id, int user2_id, int limit = 50);
+    // 重连补发：房间内last_message_id之后的公共消息，最多MAX_CATCH_UP_MESSAGES条，超出时has_more为true
+    HistoryPage get_missed_messages(int user_id, const std::string& room_id, int last_message_id);
+    std::vector<Message> get_private_chat_history(int user1_id, int user2_id, int limit = 50, int before_id = 0);
     
     // 用户管理
-    bool add_online_user(int user_id);
+    // add_online_user返回true表示用户新上线，remove_online_user返回true表示用户已完全离线
+    bool add_online_user(int user_id, const std::string& username);
     bool remove_online_user(int user_id);
+    bool update_user_status(int user_id, UserStatus status);
     std::vector<User> get_online_users_list();
+    size_t get_online_count() const;
     
     // 用户屏蔽
     bool block_user(int user_id, int blocked_user_id);
     bool unblock_user(int user_id, int blocked_user_id);
     std::vector<int> get_blocked_users(int user_id);
+    // 屏蔽了user_id的用户（升序快照），用于广播时跳过这些接收者
+    BlockGraph::UserList get_blockers(int user_id);
     
     // 消息过滤
     bool should_filter_message(int user_id, const Message& message);
     
+    // 清理过期消息（数据库与内存缓冲区）
+    bool cleanup_old_messages();
+    
+    // 写队列中尚未落盘的消息数
+    size_t get_write_queue_depth();
+    
     // 系统消息
     void broadcast_system_message(const std::string& content);
     void send_user_join_notification(const std::string& username);
@@ -56,4 +116,8 @@ public:
     
 private:
     bool is_user_blocked(int user_id, int potential_blocked_user_id);
+    
+    // 获取房间的消息缓存；create为true时按需创建并预热（必要时淘汰最久未使用的房间）。
+    // 返回的缓冲区被淘汰后对持有者仍然有效，只是不再被后续请求使用
+    std::shared_ptr<RecentMessageRing> room_history(const std::string& room_id, bool create);
 };
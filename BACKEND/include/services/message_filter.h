@@ -1,28 +1,73 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <unordered_set>
+#include "../utils/aho_corasick.h"
 
 class MessageFilter {
 private:
-    std::unordered_set<std::string> sensitive_words;
+    // 不可变的词库快照：读者通过原子shared_ptr取得后无需加锁
+    struct Dictionary {
+        std::unordered_set<std::string> words;
+        AhoCorasick matcher;
+    };
+    
+    std::shared_ptr<const Dictionary> dictionary; // 仅通过std::atomic_load/atomic_store访问
+    
+    // 以下成员仅由写者（重载/添加词）在update_mutex下访问
+    std::mutex update_mutex;
+    std::string words_file;
+    std::vector<std::string> runtime_words; // 运行时添加的词，重载时保留
+    std::filesystem::file_time_type loaded_mtime;
+    
+    // 词库文件监控线程（按修改时间轮询）
+    std::chrono::seconds poll_interval;
+    std::thread watcher;
+    std::mutex watcher_mutex;
+    std::condition_variable watcher_cv;
+    bool watching;
     
 public:
-    MessageFilter();
+    MessageFilter(const std::string& words_file = "config/sensitive_words.txt",
+                  std::chrono::seconds poll_interval = std::chrono::seconds(5));
+    ~MessageFilter();
+    
+    MessageFilter(const MessageFilter&) = delete;
+    MessageFilter& operator=(const MessageFilter&) = delete;
     
     // 初始化敏感词库
     void initialize_filter();
     void load_sensitive_words_from_file(const std::string& filename);
     void add_sensitive_word(const std::string& word);
     
+    // 从默认词、词库文件和运行时添加的词重新构建并发布快照
+    bool reload();
+    
+    // 词库热更新
+    void start_watching();
+    void stop_watching();
+    
     // 消息过滤
     std::string filter_message(const std::string& message);
     bool contains_sensitive_content(const std::string& message);
     
     // 获取过滤统计
     int get_filtered_words_count(const std::string& message);
+    size_t get_word_count() const;
     
 private:
-    std::string replace_sensitive_words(const std::string& message);
+    std::string replace_sensitive_words(const Dictionary& dict, const std::string& message);
     std::vector<std::string> get_default_sensitive_words();
+    std::shared_ptr<const Dictionary> snapshot() const;
+    void publish_locked();
+    void watch_loop();
+    
+    static bool read_words_file(const std::string& filename, std::vector<std::string>& words);
 };
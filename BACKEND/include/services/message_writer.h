@@ -0,0 +1,61 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../models/message.h"
+
+class DatabaseManager;
+
+// 消息异步持久化（写后队列 + 组提交）
+// 发送线程只把消息放入有界队列；专用写线程每隔flush_interval或攒够max_batch条
+// 就在一个事务中批量插入，避免每条消息都在请求线程上等待fsync。
+class MessageWriter {
+private:
+    std::shared_ptr<DatabaseManager> db;
+    size_t capacity;
+    size_t max_batch;
+    std::chrono::milliseconds flush_interval;
+    
+    std::deque<Message> queue;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::condition_variable flushed_cv;
+    
+    uint64_t enqueued_count;
+    uint64_t committed_count;
+    uint64_t failed_count;
+    bool flush_requested;
+    bool running;
+    std::thread worker;
+    
+public:
+    MessageWriter(std::shared_ptr<DatabaseManager> database,
+                  size_t capacity = 10000,
+                  size_t max_batch = 256,
+                  std::chrono::milliseconds flush_interval = std::chrono::milliseconds(5));
+    ~MessageWriter();
+    
+    MessageWriter(const MessageWriter&) = delete;
+    MessageWriter& operator=(const MessageWriter&) = delete;
+    
+    // 入队（消息必须已分配ID）；队列已满或已停止时返回false
+    bool enqueue(Message message);
+    
+    // 阻塞直到调用前入队的消息全部落盘
+    void flush();
+    
+    // 写入剩余消息并停止写线程
+    void stop();
+    
+    size_t get_queue_depth();
+    uint64_t get_failed_count();
+    
+private:
+    void run();
+    void write_batch(std::vector<Message>& batch);
+};
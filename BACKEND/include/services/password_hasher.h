@@ -0,0 +1,42 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 密码哈希服务
+// scrypt计算耗时且占用大量内存，放到独立的固定大小线程池中执行，结果通过回调交付，
+// 提交者无需阻塞等待；提交队列有上限，超出时立即拒绝，避免重连高峰时拖垮请求线程。
+class PasswordHasher {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    size_t queue_capacity;
+    std::mutex tasks_mutex;
+    std::condition_variable tasks_cv;
+    bool running;
+    
+public:
+    // thread_count为0时使用一半CPU核心
+    explicit PasswordHasher(size_t thread_count = 0, size_t queue_capacity = 64);
+    ~PasswordHasher();
+    
+    PasswordHasher(const PasswordHasher&) = delete;
+    PasswordHasher& operator=(const PasswordHasher&) = delete;
+    
+    // 提交任务，完成后在哈希线程上调用done（done不得抛出异常）；队列已满时返回false，done不会被调用。
+    // 析构时会执行完队列中剩余的任务。
+    bool submit_hash(const std::string& password, std::function<void(std::string)> done);
+    bool submit_verify(const std::string& password, const std::string& password_hash,
+                       std::function<void(bool)> done);
+    
+    size_t get_queue_depth();
+    
+private:
+    bool enqueue(std::function<void()> task);
+    void worker_loop();
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../models/user.h"
+
+// 在线状态表
+// 在内存中维护在线用户的用户名和状态，按连接计数（同一用户多个连接时最后一个断开才算离线），
+// 完整列表只发给新加入的客户端，其他客户端只接收增量变化。
+class PresenceTracker {
+private:
+    struct Entry {
+        std::string username;
+        UserStatus status;
+        int connections;
+    };
+    
+    std::unordered_map<int, Entry> online;
+    mutable std::shared_mutex mutex;
+    
+public:
+    // 返回true表示用户从离线变为在线
+    bool join(int user_id, const std::string& username);
+    // 返回true表示用户的最后一个连接已断开
+    bool leave(int user_id);
+    // 返回false表示用户不在线
+    bool set_status(int user_id, UserStatus status);
+    
+    bool is_online(int user_id) const;
+    size_t get_online_count() const;
+    std::vector<User> snapshot() const;
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <ctime>
+#include <deque>
+#include <shared_mutex>
+#include <vector>
+#include "../models/message.h"
+
+// 最近公共消息环形缓冲区
+// 保存最新的capacity条消息（按ID有序），由send_message/recall_message同步维护，
+// 历史记录请求优先从内存返回，只有超出缓冲范围时才回退到数据库。
+class RecentMessageRing {
+private:
+    std::deque<Message> messages;
+    size_t capacity;
+    size_t live_count;   // 未撤回的消息数
+    bool complete;       // 缓冲区是否包含全部历史（数据库中没有更早的消息）
+    mutable std::shared_mutex mutex;
+    
+public:
+    explicit RecentMessageRing(size_t capacity = 500);
+    
+    // 用数据库中最新的消息初始化（按ID升序）
+    void warm(const std::vector<Message>& recent, bool complete);
+    
+    void push(const Message& message);
+    bool mark_deleted(int message_id);
+    void evict_older_than(std::time_t cutoff);
+    
+    // 键集分页（语义同DatabaseManager::get_messages_page）
+    // 能从内存满足时填充out并返回true（按ID升序，不含已撤回消息）
+    bool get_page(int after_id, int before_id, size_t limit, std::vector<Message>& out) const;
+    
+    size_t get_capacity() const { return capacity; }
+    
+private:
+    void trim_locked();
+};
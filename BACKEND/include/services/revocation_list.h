@@ -0,0 +1,21 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+
+// 已注销用户列表
+// 记录每个用户的注销时间，拒绝此前签发的token；没有注销记录时验证路径不加锁。
+class RevocationList {
+private:
+    mutable std::shared_mutex mutex;
+    std::unordered_map<int, int64_t> revoked_before_ms;
+    std::atomic<size_t> entry_count{0};
+    
+public:
+    void revoke_user(int user_id, int64_t revoked_at_ms);
+    bool is_revoked(int user_id, int64_t issued_at_ms) const;
+    
+    // 清理超过token有效期的注销记录，返回清理数量
+    size_t evict_expired(int64_t now_ms, int64_t token_ttl_ms);
+};
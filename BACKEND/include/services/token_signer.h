@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// HMAC-SHA256签名的无状态token
+// 格式：<kid>.<base64url(claims)>.<base64url(signature)>
+// 验证只依赖密钥集，不访问数据库或任何共享会话状态；
+// 旧密钥保留在密钥集中即可继续验证，实现密钥轮换。
+class TokenSigner {
+public:
+    struct Claims {
+        int user_id = 0;
+        std::string username;
+        int64_t issued_at_ms = 0;
+        int64_t expires_at = 0; // 秒
+    };
+    
+    // 从环境变量CHATROOM_TOKEN_KEYS加载密钥（"kid:secret,kid2:secret"，第一个为签名密钥）；
+    // 未配置时生成仅本进程有效的随机密钥
+    TokenSigner();
+    
+    std::string sign(const Claims& claims) const;
+    
+    // 验证签名（常量时间比较）并解析声明，不检查过期
+    bool verify(const std::string& token, Claims& claims) const;
+    
+private:
+    struct KeySet {
+        std::unordered_map<std::string, std::string> keys;
+        std::string active_kid;
+    };
+    
+    // 读多写少：验证路径原子读取快照，轮换时整体替换
+    std::shared_ptr<const KeySet> keyset;
+    std::mutex update_mutex;
+    
+    std::shared_ptr<const KeySet> snapshot() const;
+    void load_keys_from_env();
+    
+    // 添加密钥；make_active为true时用它签发新token（轮换通过修改CHATROOM_TOKEN_KEYS后重启完成）
+    void add_key(const std::string& kid, const std::string& secret, bool make_active);
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Aho-Corasick多模式匹配自动机
+// 按字节匹配UTF-8文本，ASCII字母不区分大小写；
+// 构建后只读，可被多个线程同时使用。
+class AhoCorasick {
+public:
+    struct Match {
+        size_t start;
+        size_t length;
+    };
+    
+    AhoCorasick();
+    
+    // 添加模式串（build之前调用）
+    void add_pattern(const std::string& pattern);
+    
+    // 计算失配指针，完成后才能匹配
+    void build();
+    
+    // 一次扫描找出全部命中，包括重叠和嵌套的命中（只返回起止位于UTF-8字符边界的命中）；
+    // 按结束位置升序，同一结束位置上由长到短
+    std::vector<Match> find_all(const std::string& text) const;
+    
+    // 是否命中任意模式串
+    bool contains_any(const std::string& text) const;
+    
+    // 命中次数（包括重叠命中）
+    int count_matches(const std::string& text) const;
+    
+    size_t get_pattern_count() const { return pattern_count; }
+    
+private:
+    struct Node {
+        std::vector<std::pair<unsigned char, int32_t>> edges; // 按字节有序
+        int32_t fail = 0;
+        int32_t output = 0;     // 失配链上最近的模式结束节点（输出链接），0表示没有
+        uint16_t length = 0;    // 恰好在此结束的模式长度，0表示不是模式结尾
+        uint16_t matches = 0;   // 在此结束的模式数量（含失配链）
+    };
+    
+    std::vector<Node> nodes;
+    std::array<int32_t, 256> root_next; // 根节点的稠密转移表
+    size_t pattern_count;
+    bool built;
+    
+    static unsigned char fold(unsigned char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+    }
+    
+    int32_t find_edge(int32_t node, unsigned char c) const;
+    int32_t next_state(int32_t state, unsigned char c) const;
+    
+    // 单次扫描，对每个命中调用on_match，返回false时提前结束
+    template <typename Callback>
+    void scan(const std::string& text, Callback on_match) const {
+        if (!built || pattern_count == 0) return;
+        
+        int32_t state = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            state = next_state(state, fold(static_cast<unsigned char>(text[i])));
+            
+            size_t end = i + 1;
+            // 结束位置不在字符边界上时，在此结束的所有命中都会截断多字节字符
+            if (end < text.size() && is_utf8_continuation(static_cast<unsigned char>(text[end]))) continue;
+            
+            // 沿输出链接报告在此结束的每个模式（由长到短）
+            int32_t hit = nodes[state].length != 0 ? state : nodes[state].output;
+            for (; hit != 0; hit = nodes[hit].output) {
+                size_t length = nodes[hit].length;
+                size_t start = end - length;
+                if (is_utf8_continuation(static_cast<unsigned char>(text[start]))) continue;
+                
+                if (!on_match(Match{start, length})) return;
+            }
+        }
+    }
+    
+    static bool is_utf8_continuation(unsigned char c) {
+        return (c & 0xC0) == 0x80;
+    }
+};
@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+
+class CompressionUtils {
+public:
+    // 原始DEFLATE（无zlib头，与permessage-deflate及浏览器的deflate-raw一致）
+    static bool deflate_raw(const std::string& input, std::string& output, int level = 6);
+};
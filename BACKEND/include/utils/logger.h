@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+enum class LogLevel : uint8_t {
+    DEBUG,
+    INFO,
+    WARN,
+    ERROR
+};
+
+// 结构化日志字段（key=value），构造时不复制字符串，只在当前调用内有效
+class LogField {
+public:
+    LogField(const char* key, std::string_view value) : key(key), kind(Kind::STRING), text(value) {}
+    LogField(const char* key, const std::string& value) : key(key), kind(Kind::STRING), text(value) {}
+    LogField(const char* key, const char* value) : key(key), kind(Kind::STRING), text(value ? value : "") {}
+    LogField(const char* key, bool value) : key(key), kind(Kind::BOOL), boolean(value) {}
+    LogField(const char* key, double value) : key(key), kind(Kind::DOUBLE), real(value) {}
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+    LogField(const char* key, T value) : key(key) {
+        if constexpr (std::is_signed_v<T>) {
+            kind = Kind::INT;
+            integer = static_cast<int64_t>(value);
+        } else {
+            kind = Kind::UINT;
+            unsigned_integer = static_cast<uint64_t>(value);
+        }
+    }
+
+private:
+    friend class Logger;
+    enum class Kind { STRING, INT, UINT, DOUBLE, BOOL };
+
+    const char* key;
+    Kind kind;
+    std::string_view text;
+    union {
+        int64_t integer;
+        uint64_t unsigned_integer;
+        double real;
+        bool boolean;
+    };
+};
+
+// 异步结构化日志
+// 调用线程把记录格式化为logfmt（msg="..." key=value）后写入本线程的单生产者无锁环形缓冲区，
+// 后台线程定期取出所有线程的记录，补上时间戳和级别后批量写到stdout（WARN及以上写到stderr）。
+// 热路径不做任何控制台I/O也不加锁；缓冲区满时丢弃记录并计数，绝不阻塞调用方。
+// 环境变量：CHATROOM_LOG_LEVEL（debug/info/warn/error，默认info）、
+// CHATROOM_LOG_SAMPLE（逐消息调试日志每N条记录一条，默认100）。
+class Logger {
+public:
+    static bool enabled(LogLevel level);
+
+    static void log(LogLevel level, std::string_view message, std::initializer_list<LogField> fields = {});
+    static void debug(std::string_view message, std::initializer_list<LogField> fields = {});
+    static void info(std::string_view message, std::initializer_list<LogField> fields = {});
+    static void warn(std::string_view message, std::initializer_list<LogField> fields = {});
+    static void error(std::string_view message, std::initializer_list<LogField> fields = {});
+
+    // 逐消息调试日志：开启DEBUG时每个线程每CHATROOM_LOG_SAMPLE条只记录一条
+    static void debug_sampled(std::string_view message, std::initializer_list<LogField> fields = {});
+
+    // 阻塞直到此前写入的记录全部输出
+    static void flush();
+
+    static uint64_t get_dropped_count();
+
+private:
+    static void format_field(std::string& out, const LogField& field);
+    static void append_value(std::string& out, std::string_view value);
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// 无锁计数器
+class Counter {
+public:
+    void inc(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+// 无锁直方图（HDR式对数-线性分桶）
+// 小于16的值每个值一个桶；此后每个2的幂区间再线性分为16个子桶，
+// 桶宽不超过下界的1/16，分位数相对误差不超过6.25%。
+// 覆盖0到2^27-1（微秒约134秒），更大的值计入+Inf桶；记录一次只是三次fetch_add。
+class Histogram {
+public:
+    static constexpr size_t SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t MAX_VALUE_BITS = 27;
+    static constexpr size_t BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + 1; // 最后一个桶为+Inf
+
+    void observe(uint64_t value);
+
+    uint64_t get_count() const { return count.load(std::memory_order_relaxed); }
+    uint64_t get_sum() const { return sum.load(std::memory_order_relaxed); }
+    uint64_t get_bucket(size_t index) const { return buckets[index].load(std::memory_order_relaxed); }
+    // 第index个桶包含的最大值（原始单位）
+    static uint64_t bucket_bound(size_t index);
+    // value所在的桶
+    static size_t bucket_index(uint64_t value);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+};
+
+// 作用域计时，析构时把耗时（微秒）记入直方图
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+// 指标注册表（Prometheus文本格式）
+// 注册只在启动或首次使用时发生（热路径用函数内静态引用缓存返回值），
+// 记录过程不加锁；回调指标在抓取时读取各组件的当前值（连接数、队列深度等）。
+class Metrics {
+public:
+    enum class Unit {
+        MICROSECONDS, // 导出为秒
+        COUNT
+    };
+
+    static Metrics& instance();
+
+    // 同名同标签重复注册返回同一对象；labels形如 method="save_message"
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "",
+                         Unit unit = Unit::MICROSECONDS);
+    // 抓取时调用read；counter_type为true时导出为counter，否则为gauge
+    void callback(const std::string& name, const std::string& help, std::function<double()> read,
+                  bool counter_type = false, const std::string& labels = "");
+
+    std::string render() const;
+
+private:
+    enum class Kind { COUNTER, HISTOGRAM, CALLBACK };
+
+    struct Entry {
+        Kind kind;
+        std::string name;
+        std::string help;
+        std::string labels;
+        Unit unit = Unit::COUNT;
+        bool counter_type = false;
+        Counter counter;
+        Histogram histogram;
+        std::function<double()> read;
+    };
+
+    mutable std::mutex mutex;
+    std::deque<Entry> entries; // deque保证元素地址稳定
+
+    Metrics() = default;
+    Entry& find_or_add(Kind kind, const std::string& name, const std::string& help, const std::string& labels);
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+// 无锁令牌桶限流器
+// 键（用户ID或IP哈希）散列到固定大小的桶数组，每个桶是一个64位原子字：
+// 高40位为上次补充令牌的时间（毫秒），低24位为已消耗的令牌（1/256令牌为单位）。
+// 全零的桶即满桶，无需初始化或回收；哈希冲突的键共享同一个桶（只会更严格）。
+class RateLimiter {
+public:
+    struct Limits {
+        uint32_t burst;            // 桶容量（最多65535）
+        double refill_per_second;  // 每秒补充的令牌数
+
+        // 从环境变量<prefix>_BURST、<prefix>_RATE读取，未设置或非法时使用defaults
+        static Limits from_env(const char* prefix, Limits defaults);
+    };
+
+    explicit RateLimiter(Limits limits, size_t bucket_count = 65536);
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    // 消耗一个令牌；桶已空时返回false
+    bool try_acquire(uint64_t key);
+
+    uint64_t get_rejected_count() const { return rejected.load(std::memory_order_relaxed); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int TIME_SHIFT = 24;
+    static constexpr uint64_t DEFICIT_MASK = (uint64_t(1) << TIME_SHIFT) - 1;
+    static constexpr uint64_t TOKEN_UNIT = 256;
+
+    const uint64_t capacity;       // burst * TOKEN_UNIT
+    const double refill_per_ms;    // 每毫秒补充的单位数
+    const Clock::time_point epoch;
+    const size_t mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+    std::atomic<uint64_t> rejected{0};
+};
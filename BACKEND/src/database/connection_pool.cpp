@@ -0,0 +1,146 @@
+#include "../include/database/connection_pool.h"
+#include "../include/utils/logger.h"
+#include <algorithm>
+#include <thread>
+
+PooledConnection::~PooledConnection() {
+    // 先释放预编译语句，否则连接无法关闭
+    statements.clear();
+    if (handle) {
+        sqlite3_close(handle);
+    }
+}
+
+ConnectionPool::Lease::Lease(ConnectionPool* pool, PooledConnection* connection,
+                             std::unique_lock<std::mutex> writer_lock)
+    : pool(pool), connection(connection), writer_lock(std::move(writer_lock)) {}
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool(other.pool), connection(other.connection), writer_lock(std::move(other.writer_lock)) {
+    other.pool = nullptr;
+    other.connection = nullptr;
+}
+
+ConnectionPool::Lease::~Lease() {
+    // 写连接随writer_lock释放；只读连接归还到空闲列表
+    if (pool && connection && !writer_lock.owns_lock()) {
+        pool->release_reader(connection);
+    }
+}
+
+sqlite3_stmt* ConnectionPool::Lease::statement(const std::string& query) const {
+    return connection ? connection->statements.get(query) : nullptr;
+}
+
+ConnectionPool::ConnectionPool(const std::string& db_path, size_t reader_count)
+    : db_path(db_path), reader_count(reader_count) {
+    if (this->reader_count == 0) {
+        this->reader_count = std::max(2u, std::thread::hardware_concurrency());
+    }
+}
+
+bool ConnectionPool::open() {
+    // 写连接先打开：负责创建数据库文件并切换到WAL模式
+    writer = std::make_unique<PooledConnection>();
+    if (!open_connection(*writer, false)) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(readers_mutex);
+    for (size_t i = 0; i < reader_count; ++i) {
+        auto reader = std::make_unique<PooledConnection>();
+        if (!open_connection(*reader, true)) {
+            return false;
+        }
+        idle_readers.push_back(reader.get());
+        readers.push_back(std::move(reader));
+    }
+    
+    return true;
+}
+
+bool ConnectionPool::prepare_statements(const std::vector<std::string>& reader_queries,
+                                        const std::vector<std::string>& writer_queries) {
+    std::lock_guard<std::mutex> writer_guard(writer_mutex);
+    if (!writer || !writer->statements.prepare_all(writer_queries)) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> readers_guard(readers_mutex);
+    for (auto& reader : readers) {
+        if (!reader->statements.prepare_all(reader_queries)) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+ConnectionPool::Lease ConnectionPool::acquire_reader() {
+    std::unique_lock<std::mutex> lock(readers_mutex);
+    readers_cv.wait(lock, [this]() { return !idle_readers.empty() || readers.empty(); });
+    
+    if (idle_readers.empty()) {
+        return Lease(nullptr, nullptr, std::unique_lock<std::mutex>());
+    }
+    
+    PooledConnection* connection = idle_readers.back();
+    idle_readers.pop_back();
+    return Lease(this, connection, std::unique_lock<std::mutex>());
+}
+
+ConnectionPool::Lease ConnectionPool::acquire_writer() {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    return Lease(this, writer.get(), std::move(lock));
+}
+
+void ConnectionPool::release_reader(PooledConnection* connection) {
+    {
+        std::lock_guard<std::mutex> lock(readers_mutex);
+        idle_readers.push_back(connection);
+    }
+    readers_cv.notify_one();
+}
+
+bool ConnectionPool::open_connection(PooledConnection& connection, bool read_only) {
+    int flags = SQLITE_OPEN_NOMUTEX | (read_only ? SQLITE_OPEN_READONLY
+                                                 : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    
+    int rc = sqlite3_open_v2(db_path.c_str(), &connection.handle, flags, nullptr);
+    if (rc != SQLITE_OK) {
+        Logger::error("Can't open database", {{"path", db_path}, {"error", sqlite3_errmsg(connection.handle)}});
+        return false;
+    }
+    
+    connection.statements.set_database(connection.handle);
+    return apply_pragmas(connection.handle, read_only);
+}
+
+bool ConnectionPool::apply_pragmas(sqlite3* handle, bool read_only) {
+    sqlite3_busy_timeout(handle, 5000);
+    
+    std::vector<std::string> pragmas = {
+        "PRAGMA cache_size = -16000",      // 16MB页缓存
+        "PRAGMA mmap_size = 268435456",    // 256MB内存映射
+        "PRAGMA temp_store = MEMORY"
+    };
+    
+    if (!read_only) {
+        // WAL为数据库文件级设置，由写连接设置一次即可
+        pragmas.insert(pragmas.begin(), {
+            "PRAGMA journal_mode = WAL",
+            "PRAGMA synchronous = NORMAL"
+        });
+    }
+    
+    for (const auto& pragma : pragmas) {
+        char* err_msg = nullptr;
+        if (sqlite3_exec(handle, pragma.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK) {
+            Logger::error("SQL error", {{"query", pragma}, {"error", err_msg ? err_msg : "unknown"}});
+            sqlite3_free(err_msg);
+            return false;
+        }
+    }
+    
+    return true;
+}
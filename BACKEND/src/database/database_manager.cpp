@@ -1,24 +1,203 @@
 #include "../include/database/database_manager.h"
-#include <iostream>
+#include "../include/utils/logger.h"
+#include "../include/utils/metrics.h"
+#include <algorithm>
+#include <climits>
 #include <sstream>
 
-DatabaseManager::DatabaseManager(const std::string& db_path) 
-    : db(nullptr), db_path(db_path) {}
+namespace {
 
-DatabaseManager::~DatabaseManager() {
-    if (db) {
-        sqlite3_close(db);
-    }
+// 各方法的语句耗时（按方法名区分）
+Histogram& statement_latency(const char* method) {
+    return Metrics::instance().histogram("chatroom_db_statement_seconds",
+                                         "Latency of DatabaseManager methods",
+                                         std::string("method=\"") + method + "\"");
 }
 
+const std::string SQL_CREATE_USER = R"(
+        INSERT INTO users (username, password_hash, email, status)
+        VALUES (?, ?, ?, ?)
+    )";
+
+const std::string SQL_GET_USER_BY_USERNAME =
+    "SELECT id, username, password_hash, email, status, created_at, last_seen FROM users WHERE username = ?";
+
+const std::string SQL_GET_USER_BY_ID =
+    "SELECT id, username, password_hash, email, status, created_at, last_seen FROM users WHERE id = ?";
+
+// 消息ID由DatabaseManager预分配，时间戳使用服务器时间（UTC）；
+// RETURNING在同一次执行中返回实际存储的ID和时间戳，无需再次查询
+const std::string SQL_SAVE_MESSAGE = R"(
+        INSERT INTO messages (id, sender_id, receiver_id, content, type, timestamp, room_id)
+        VALUES (?, ?, ?, ?, ?, COALESCE(datetime(?, 'unixepoch'), CURRENT_TIMESTAMP), ?)
+        RETURNING id, CAST(strftime('%s', timestamp) AS INTEGER)
+    )";
+
+const std::string SQL_GET_MAX_MESSAGE_ID = R"(
+        SELECT MAX(
+            COALESCE((SELECT MAX(id) FROM messages), 0),
+            COALESCE((SELECT seq FROM sqlite_sequence WHERE name = 'messages'), 0)
+        )
+    )";
+
+const std::string SQL_GET_RECENT_MESSAGES = R"(
+        SELECT m.id, m.sender_id, m.receiver_id, m.content, m.type,
+               CAST(strftime('%s', m.timestamp) AS INTEGER), m.is_deleted, u.username, m.room_id
+        FROM messages m
+        JOIN users u ON m.sender_id = u.id
+        WHERE m.room_id = ? AND m.type = 'PUBLIC' AND m.is_deleted = 0
+        ORDER BY m.id DESC
+        LIMIT ?
+    )";
+
+// 键集分页：以消息ID为游标，借助(room_id, type, is_deleted, id)索引只扫描一页数据
+const std::string SQL_GET_MESSAGES_BEFORE_ID = R"(
+        SELECT m.id, m.sender_id, m.receiver_id, m.content, m.type,
+               CAST(strftime('%s', m.timestamp) AS INTEGER), m.is_deleted, u.username, m.room_id
+        FROM messages m
+        JOIN users u ON m.sender_id = u.id
+        WHERE m.room_id = ? AND m.type = 'PUBLIC' AND m.is_deleted = 0 AND m.id < ? AND m.id > ?
+        ORDER BY m.id DESC
+        LIMIT ?
+    )";
+
+const std::string SQL_GET_MESSAGES_AFTER_ID = R"(
+        SELECT m.id, m.sender_id, m.receiver_id, m.content, m.type,
+               CAST(strftime('%s', m.timestamp) AS INTEGER), m.is_deleted, u.username, m.room_id
+        FROM messages m
+        JOIN users u ON m.sender_id = u.id
+        WHERE m.room_id = ? AND m.type = 'PUBLIC' AND m.is_deleted = 0 AND m.id > ? AND m.id < ?
+        ORDER BY m.id ASC
+        LIMIT ?
+    )";
+
+const std::string SQL_UPDATE_USER_STATUS =
+    "UPDATE users SET status = ?, last_seen = CURRENT_TIMESTAMP WHERE id = ?";
+
+const std::string SQL_UPDATE_USER_PASSWORD_HASH =
+    "UPDATE users SET password_hash = ? WHERE id = ?";
+
+const std::string SQL_BLOCK_USER =
+    "INSERT OR IGNORE INTO blocked_users (user_id, blocked_user_id) VALUES (?, ?)";
+
+const std::string SQL_GET_BLOCKED_USERS =
+    "SELECT blocked_user_id FROM blocked_users WHERE user_id = ?";
+
+const std::string SQL_GET_ALL_BLOCKS =
+    "SELECT user_id, blocked_user_id FROM blocked_users";
+
+const std::string SQL_UNBLOCK_USER =
+    "DELETE FROM blocked_users WHERE user_id = ? AND blocked_user_id = ?";
+
+const std::string SQL_SAVE_REVOCATION =
+    "INSERT OR REPLACE INTO token_revocations (user_id, revoked_before_ms) VALUES (?, ?)";
+
+const std::string SQL_GET_REVOCATIONS =
+    "SELECT user_id, revoked_before_ms FROM token_revocations WHERE revoked_before_ms >= ?";
+
+const std::string SQL_DELETE_REVOCATIONS_BEFORE =
+    "DELETE FROM token_revocations WHERE revoked_before_ms < ?";
+
+// 两个方向各自走(sender_id, receiver_id, id)索引取一页，再合并排序
+const std::string SQL_GET_PRIVATE_MESSAGES = R"(
+        SELECT m.id, m.sender_id, m.receiver_id, m.content, m.type,
+               CAST(strftime('%s', m.timestamp) AS INTEGER), m.is_deleted, u.username, m.room_id
+        FROM (
+            SELECT * FROM (
+                SELECT id FROM messages
+                WHERE sender_id = ?1 AND receiver_id = ?2 AND id < ?3
+                  AND type = 'PRIVATE' AND is_deleted = 0
+                ORDER BY id DESC LIMIT ?4
+            )
+            UNION ALL
+            SELECT * FROM (
+                SELECT id FROM messages
+                WHERE sender_id = ?2 AND receiver_id = ?1 AND id < ?3
+                  AND type = 'PRIVATE' AND is_deleted = 0
+                ORDER BY id DESC LIMIT ?4
+            )
+        ) page
+        JOIN messages m ON m.id = page.id
+        JOIN users u ON m.sender_id = u.id
+        ORDER BY m.id DESC
+        LIMIT ?4
+    )";
+
+const std::string SQL_GET_MESSAGE_OWNER =
+    "SELECT sender_id, room_id FROM messages WHERE id = ?";
+
+const std::string SQL_GET_MESSAGES_COLUMNS =
+    "SELECT name FROM pragma_table_info('messages')";
+
+const std::string SQL_MARK_MESSAGE_DELETED =
+    "UPDATE messages SET is_deleted = 1 WHERE id = ?";
+
+const std::string SQL_MARK_MESSAGE_READ =
+    "INSERT OR REPLACE INTO message_read_status (message_id, user_id) VALUES (?, ?)";
+
+const std::string SQL_GET_ONLINE_USERS =
+    "SELECT id, username, password_hash, email, status, created_at, last_seen FROM users WHERE status != 'OFFLINE'";
+
+} // namespace
+
+DatabaseManager::DatabaseManager(const std::string& db_path, size_t reader_count) 
+    : db_path(db_path), pool(db_path, reader_count) {}
+
+DatabaseManager::~DatabaseManager() {}
+
 bool DatabaseManager::initialize() {
-    int rc = sqlite3_open(db_path.c_str(), &db);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    // 写连接负责建库并切换WAL，之后才能打开只读连接
+    if (!pool.open()) {
         return false;
     }
     
-    return create_tables();
+    return create_tables() && prepare_statements() && load_message_id_seed();
+}
+
+bool DatabaseManager::load_message_id_seed() {
+    auto conn = pool.acquire_writer();
+    ScopedStatement stmt(conn.statement(SQL_GET_MAX_MESSAGE_ID));
+    
+    if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW) {
+        return false;
+    }
+    
+    last_message_id = sqlite3_column_int(stmt.get(), 0);
+    return true;
+}
+
+int DatabaseManager::reserve_message_id() {
+    return ++last_message_id;
+}
+
+bool DatabaseManager::prepare_statements() {
+    return pool.prepare_statements(
+        {
+            SQL_GET_USER_BY_USERNAME,
+            SQL_GET_USER_BY_ID,
+            SQL_GET_RECENT_MESSAGES,
+            SQL_GET_MESSAGES_BEFORE_ID,
+            SQL_GET_MESSAGES_AFTER_ID,
+            SQL_GET_BLOCKED_USERS,
+            SQL_GET_ALL_BLOCKS,
+            SQL_GET_REVOCATIONS,
+            SQL_GET_PRIVATE_MESSAGES,
+            SQL_GET_ONLINE_USERS
+        },
+        {
+            SQL_CREATE_USER,
+            SQL_SAVE_MESSAGE,
+            SQL_GET_MAX_MESSAGE_ID,
+            SQL_UPDATE_USER_STATUS,
+            SQL_UPDATE_USER_PASSWORD_HASH,
+            SQL_BLOCK_USER,
+            SQL_UNBLOCK_USER,
+            SQL_SAVE_REVOCATION,
+            SQL_DELETE_REVOCATIONS_BEFORE,
+            SQL_GET_MESSAGE_OWNER,
+            SQL_MARK_MESSAGE_DELETED,
+            SQL_MARK_MESSAGE_READ
+        });
 }
 
 bool DatabaseManager::create_tables() {
@@ -45,6 +224,7 @@ bool DatabaseManager::create_tables() {
             type TEXT DEFAULT 'PUBLIC',
             timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,
             is_deleted BOOLEAN DEFAULT 0,
+            room_id TEXT NOT NULL DEFAULT 'general',
             FOREIGN KEY (sender_id) REFERENCES users(id),
             FOREIGN KEY (receiver_id) REFERENCES users(id)
         )
@@ -76,296 +256,470 @@ bool DatabaseManager::create_tables() {
         )
     )";
     
-    return execute_query(create_users_table) &&
-           execute_query(create_messages_table) &&
-           execute_query(create_blocked_users_table) &&
-           execute_query(create_message_read_status_table);
+    // token注销表：每个用户最近一次注销的时间，此前签发的token无效（重启后仍然生效）
+    std::string create_token_revocations_table = R"(
+        CREATE TABLE IF NOT EXISTS token_revocations (
+            user_id INTEGER PRIMARY KEY,
+            revoked_before_ms INTEGER NOT NULL,
+            FOREIGN KEY (user_id) REFERENCES users(id)
+        )
+    )";
+    
+    // 消息表索引：公共消息按房间和ID分页、私聊按会话双方分页
+    // （旧的(type, is_deleted, id)索引已被房间索引取代）
+    std::string create_messages_indexes = R"(
+        DROP INDEX IF EXISTS idx_messages_type_deleted_id;
+        CREATE INDEX IF NOT EXISTS idx_messages_room_type_deleted_id
+            ON messages (room_id, type, is_deleted, id);
+        CREATE INDEX IF NOT EXISTS idx_messages_sender_receiver_id
+            ON messages (sender_id, receiver_id, id);
+    )";
+    
+    auto conn = pool.acquire_writer();
+    return execute_query(conn.handle(), create_users_table) &&
+           execute_query(conn.handle(), create_messages_table) &&
+           migrate_messages_table(conn.handle()) &&
+           execute_query(conn.handle(), create_blocked_users_table) &&
+           execute_query(conn.handle(), create_message_read_status_table) &&
+           execute_query(conn.handle(), create_token_revocations_table) &&
+           execute_query(conn.handle(), create_messages_indexes);
+}
+
+bool DatabaseManager::migrate_messages_table(sqlite3* handle) {
+    // 旧版本数据库没有room_id列，已有消息归入默认房间
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(handle, SQL_GET_MESSAGES_COLUMNS.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    bool has_room_id = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))) == "room_id") {
+            has_room_id = true;
+        }
+    }
+    sqlite3_finalize(stmt);
+    
+    if (has_room_id) {
+        return true;
+    }
+    
+    return execute_query(handle, "ALTER TABLE messages ADD COLUMN room_id TEXT NOT NULL DEFAULT 'general'");
 }
 
 bool DatabaseManager::create_user(const User& user) {
-    std::string query = R"(
-        INSERT INTO users (username, password_hash, email, status)
-        VALUES (?, ?, ?, ?)
-    )";
+    static Histogram& latency = statement_latency("create_user");
+    ScopedTimer timer(latency);
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_writer();
+    ScopedStatement stmt(conn.statement(SQL_CREATE_USER));
     
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
+    if (!stmt) {
         return false;
     }
     
-    sqlite3_bind_text(stmt, 1, user.username.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, user.password_hash.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, user.email.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 4, User::status_to_string(user.status).c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 1, user.username.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 2, user.password_hash.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 3, user.email.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 4, User::status_to_string(user.status).c_str(), -1, SQLITE_TRANSIENT);
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    
-    return rc == SQLITE_DONE;
+    return sqlite3_step(stmt.get()) == SQLITE_DONE;
 }
 
 std::unique_ptr<User> DatabaseManager::get_user_by_username(const std::string& username) {
-    std::string query = "SELECT id, username, password_hash, email, status, created_at, last_seen FROM users WHERE username = ?";
+    static Histogram& latency = statement_latency("get_user_by_username");
+    ScopedTimer timer(latency);
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_reader();
+    ScopedStatement stmt(conn.statement(SQL_GET_USER_BY_USERNAME));
     
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
+    if (!stmt) {
         return nullptr;
     }
     
-    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 1, username.c_str(), -1, SQLITE_STATIC);
     
     std::unique_ptr<User> user = nullptr;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
         user = std::make_unique<User>();
-        user->id = sqlite3_column_int(stmt, 0);
-        user->username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        user->password_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        user->email = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        user->status = User::string_to_status(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
+        user->id = sqlite3_column_int(stmt.get(), 0);
+        user->username = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
+        user->password_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 2));
+        user->email = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 3));
+        user->status = User::string_to_status(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 4)));
         // 时间戳处理可以在这里添加
     }
     
-    sqlite3_finalize(stmt);
     return user;
 }
 
 std::unique_ptr<User> DatabaseManager::get_user_by_id(int user_id) {
-    std::string query = "SELECT id, username, password_hash, email, status, created_at, last_seen FROM users WHERE id = ?";
+    static Histogram& latency = statement_latency("get_user_by_id");
+    ScopedTimer timer(latency);
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_reader();
+    ScopedStatement stmt(conn.statement(SQL_GET_USER_BY_ID));
     
-    if (rc != SQLITE_OK) {
+    if (!stmt) {
         return nullptr;
     }
     
-    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt.get(), 1, user_id);
     
     std::unique_ptr<User> user = nullptr;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
         user = std::make_unique<User>();
-        user->id = sqlite3_column_int(stmt, 0);
-        user->username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        user->password_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        user->email = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        user->status = User::string_to_status(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
+        user->id = sqlite3_column_int(stmt.get(), 0);
+        user->username = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
+        user->password_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 2));
+        user->email = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 3));
+        user->status = User::string_to_status(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 4)));
     }
     
-    sqlite3_finalize(stmt);
     return user;
 }
 
-bool DatabaseManager::save_message(const Message& message) {
-    std::string query = R"(
-        INSERT INTO messages (sender_id, receiver_id, content, type)
-        VALUES (?, ?, ?, ?)
-    )";
+bool DatabaseManager::save_message(Message& message) {
+    static Histogram& latency = statement_latency("save_message");
+    ScopedTimer timer(latency);
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_writer();
+    return insert_message(conn, message);
+}
+
+bool DatabaseManager::save_messages(std::vector<Message>& messages) {
+    static Histogram& latency = statement_latency("save_messages");
+    ScopedTimer timer(latency);
     
-    if (rc != SQLITE_OK) {
+    if (messages.empty()) {
+        return true;
+    }
+    
+    // 一批消息合并到同一个事务中，只提交一次
+    auto conn = pool.acquire_writer();
+    if (!execute_query(conn.handle(), "BEGIN IMMEDIATE")) {
         return false;
     }
     
-    sqlite3_bind_int(stmt, 1, message.sender_id);
-    sqlite3_bind_int(stmt, 2, message.receiver_id);
-    sqlite3_bind_text(stmt, 3, message.content.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 4, Message::type_to_string(message.type).c_str(), -1, SQLITE_STATIC);
+    for (auto& message : messages) {
+        if (!insert_message(conn, message)) {
+            execute_query(conn.handle(), "ROLLBACK");
+            return false;
+        }
+    }
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    return execute_query(conn.handle(), "COMMIT");
+}
+
+bool DatabaseManager::insert_message(const ConnectionPool::Lease& conn, Message& message) {
+    ScopedStatement stmt(conn.statement(SQL_SAVE_MESSAGE));
+    
+    if (!stmt) {
+        return false;
+    }
+    
+    int message_id = message.id > 0 ? message.id : reserve_message_id();
+    
+    sqlite3_bind_int(stmt.get(), 1, message_id);
+    sqlite3_bind_int(stmt.get(), 2, message.sender_id);
+    sqlite3_bind_int(stmt.get(), 3, message.receiver_id);
+    sqlite3_bind_text(stmt.get(), 4, message.content.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 5, Message::type_to_string(message.type).c_str(), -1, SQLITE_TRANSIENT);
+    if (message.timestamp > 0) {
+        sqlite3_bind_int64(stmt.get(), 6, static_cast<sqlite3_int64>(message.timestamp));
+    } else {
+        sqlite3_bind_null(stmt.get(), 6);
+    }
+    sqlite3_bind_text(stmt.get(), 7, message.room_id.c_str(), -1, SQLITE_STATIC);
+    
+    if (sqlite3_step(stmt.get()) != SQLITE_ROW) {
+        return false;
+    }
+    
+    // 回填数据库实际存储的ID和时间戳
+    message.id = sqlite3_column_int(stmt.get(), 0);
+    message.timestamp = static_cast<std::time_t>(sqlite3_column_int64(stmt.get(), 1));
     
-    return rc == SQLITE_DONE;
+    return sqlite3_step(stmt.get()) == SQLITE_DONE;
 }
 
-std::vector<Message> DatabaseManager::get_recent_messages(int limit) {
+std::vector<Message> DatabaseManager::get_recent_messages(const std::string& room_id, int limit) {
+    static Histogram& latency = statement_latency("get_recent_messages");
+    ScopedTimer timer(latency);
+    
     std::vector<Message> messages;
-    std::string query = R"(
-        SELECT m.id, m.sender_id, m.receiver_id, m.content, m.type, m.timestamp, m.is_deleted, u.username
-        FROM messages m
-        JOIN users u ON m.sender_id = u.id
-        WHERE m.is_deleted = 0 AND m.type = 'PUBLIC'
-        ORDER BY m.timestamp DESC
-        LIMIT ?
-    )";
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_reader();
+    ScopedStatement stmt(conn.statement(SQL_GET_RECENT_MESSAGES));
     
-    if (rc != SQLITE_OK) {
+    if (!stmt) {
         return messages;
     }
     
-    sqlite3_bind_int(stmt, 1, limit);
-    
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Message message;
-        message.id = sqlite3_column_int(stmt, 0);
-        message.sender_id = sqlite3_column_int(stmt, 1);
-        message.receiver_id = sqlite3_column_int(stmt, 2);
-        message.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        message.type = Message::string_to_type(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
-        message.is_deleted = sqlite3_column_int(stmt, 6) == 1;
-        message.sender_username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-        messages.push_back(message);
-    }
+    sqlite3_bind_text(stmt.get(), 1, room_id.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt.get(), 2, limit);
     
-    sqlite3_finalize(stmt);
+    read_messages(stmt.get(), messages);
     
     // 反转顺序，让最新的消息在最后
     std::reverse(messages.begin(), messages.end());
     return messages;
 }
 
+std::vector<Message> DatabaseManager::get_messages_page(const std::string& room_id, int after_id, 
+                                                        int before_id, int limit) {
+    static Histogram& latency = statement_latency("get_messages_page");
+    ScopedTimer timer(latency);
+    
+    std::vector<Message> messages;
+    
+    // 指定after_id时从游标向新消息方向翻页，否则从before_id向旧消息方向翻页
+    bool forward = after_id > 0;
+    int upper = before_id > 0 ? before_id : INT_MAX;
+    
+    auto conn = pool.acquire_reader();
+    ScopedStatement stmt(conn.statement(forward ? SQL_GET_MESSAGES_AFTER_ID : SQL_GET_MESSAGES_BEFORE_ID));
+    
+    if (!stmt) {
+        return messages;
+    }
+    
+    sqlite3_bind_text(stmt.get(), 1, room_id.c_str(), -1, SQLITE_STATIC);
+    if (forward) {
+        sqlite3_bind_int(stmt.get(), 2, after_id);
+        sqlite3_bind_int(stmt.get(), 3, upper);
+    } else {
+        sqlite3_bind_int(stmt.get(), 2, upper);
+        sqlite3_bind_int(stmt.get(), 3, after_id);
+    }
+    sqlite3_bind_int(stmt.get(), 4, limit);
+    
+    read_messages(stmt.get(), messages);
+    
+    // 统一按ID升序返回
+    if (!forward) {
+        std::reverse(messages.begin(), messages.end());
+    }
+    return messages;
+}
+
 bool DatabaseManager::update_user_status(int user_id, UserStatus status) {
-    std::string query = "UPDATE users SET status = ?, last_seen = CURRENT_TIMESTAMP WHERE id = ?";
+    static Histogram& latency = statement_latency("update_user_status");
+    ScopedTimer timer(latency);
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_writer();
+    ScopedStatement stmt(conn.statement(SQL_UPDATE_USER_STATUS));
     
-    if (rc != SQLITE_OK) {
+    if (!stmt) {
         return false;
     }
     
-    sqlite3_bind_text(stmt, 1, User::status_to_string(status).c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 2, user_id);
+    sqlite3_bind_text(stmt.get(), 1, User::status_to_string(status).c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt.get(), 2, user_id);
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    return sqlite3_step(stmt.get()) == SQLITE_DONE;
+}
+
+bool DatabaseManager::update_user_password_hash(int user_id, const std::string& password_hash) {
+    static Histogram& latency = statement_latency("update_user_password_hash");
+    ScopedTimer timer(latency);
+    
+    auto conn = pool.acquire_writer();
+    ScopedStatement stmt(conn.statement(SQL_UPDATE_USER_PASSWORD_HASH));
     
-    return rc == SQLITE_DONE;
+    if (!stmt) {
+        return false;
+    }
+    
+    sqlite3_bind_text(stmt.get(), 1, password_hash.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt.get(), 2, user_id);
+    
+    return sqlite3_step(stmt.get()) == SQLITE_DONE;
 }
 
 bool DatabaseManager::block_user(int user_id, int blocked_user_id) {
-    std::string query = "INSERT OR IGNORE INTO blocked_users (user_id, blocked_user_id) VALUES (?, ?)";
+    static Histogram& latency = statement_latency("block_user");
+    ScopedTimer timer(latency);
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_writer();
+    ScopedStatement stmt(conn.statement(SQL_BLOCK_USER));
     
-    if (rc != SQLITE_OK) {
+    if (!stmt) {
         return false;
     }
     
-    sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_int(stmt, 2, blocked_user_id);
-    
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_bind_int(stmt.get(), 1, user_id);
+    sqlite3_bind_int(stmt.get(), 2, blocked_user_id);
     
-    return rc == SQLITE_DONE;
+    return sqlite3_step(stmt.get()) == SQLITE_DONE;
 }
 
 std::vector<int> DatabaseManager::get_blocked_users(int user_id) {
+    static Histogram& latency = statement_latency("get_blocked_users");
+    ScopedTimer timer(latency);
+    
     std::vector<int> blocked_users;
-    std::string query = "SELECT blocked_user_id FROM blocked_users WHERE user_id = ?";
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_reader();
+    ScopedStatement stmt(conn.statement(SQL_GET_BLOCKED_USERS));
     
-    if (rc != SQLITE_OK) {
+    if (!stmt) {
         return blocked_users;
     }
     
-    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt.get(), 1, user_id);
     
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        blocked_users.push_back(sqlite3_column_int(stmt, 0));
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+        blocked_users.push_back(sqlite3_column_int(stmt.get(), 0));
     }
     
-    sqlite3_finalize(stmt);
     return blocked_users;
 }
 
+std::vector<std::pair<int, int>> DatabaseManager::get_all_blocks() {
+    static Histogram& latency = statement_latency("get_all_blocks");
+    ScopedTimer timer(latency);
+    
+    std::vector<std::pair<int, int>> blocks;
+    
+    auto conn = pool.acquire_reader();
+    ScopedStatement stmt(conn.statement(SQL_GET_ALL_BLOCKS));
+    
+    if (!stmt) {
+        return blocks;
+    }
+    
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+        blocks.emplace_back(sqlite3_column_int(stmt.get(), 0), sqlite3_column_int(stmt.get(), 1));
+    }
+    
+    return blocks;
+}
+
 bool DatabaseManager::unblock_user(int user_id, int blocked_user_id) {
-    std::string query = "DELETE FROM blocked_users WHERE user_id = ? AND blocked_user_id = ?";
+    static Histogram& latency = statement_latency("unblock_user");
+    ScopedTimer timer(latency);
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_writer();
+    ScopedStatement stmt(conn.statement(SQL_UNBLOCK_USER));
     
-    if (rc != SQLITE_OK) {
+    if (!stmt) {
         return false;
     }
     
-    sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_int(stmt, 2, blocked_user_id);
-    
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_bind_int(stmt.get(), 1, user_id);
+    sqlite3_bind_int(stmt.get(), 2, blocked_user_id);
     
-    return rc == SQLITE_DONE;
+    return sqlite3_step(stmt.get()) == SQLITE_DONE;
 }
 
-std::vector<Message> DatabaseManager::get_private_messages(int user1_id, int user2_id, int limit) {
-    std::vector<Message> messages;
-    std::string query = R"(
-        SELECT m.id, m.sender_id, m.receiver_id, m.content, m.type, m.timestamp, m.is_deleted, u.username
-        FROM messages m
-        JOIN users u ON m.sender_id = u.id
-        WHERE m.type = 'PRIVATE' AND m.is_deleted = 0 
-        AND ((m.sender_id = ? AND m.receiver_id = ?) OR (m.sender_id = ? AND m.receiver_id = ?))
-        ORDER BY m.timestamp DESC
-        LIMIT ?
-    )";
+bool DatabaseManager::save_revocation(int user_id, int64_t revoked_before_ms) {
+    static Histogram& latency = statement_latency("save_revocation");
+    ScopedTimer timer(latency);
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_writer();
+    ScopedStatement stmt(conn.statement(SQL_SAVE_REVOCATION));
     
-    if (rc != SQLITE_OK) {
-        return messages;
+    if (!stmt) {
+        return false;
     }
     
-    sqlite3_bind_int(stmt, 1, user1_id);
-    sqlite3_bind_int(stmt, 2, user2_id);
-    sqlite3_bind_int(stmt, 3, user2_id);
-    sqlite3_bind_int(stmt, 4, user1_id);
-    sqlite3_bind_int(stmt, 5, limit);
+    sqlite3_bind_int(stmt.get(), 1, user_id);
+    sqlite3_bind_int64(stmt.get(), 2, static_cast<sqlite3_int64>(revoked_before_ms));
     
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Message message;
-        message.id = sqlite3_column_int(stmt, 0);
-        message.sender_id = sqlite3_column_int(stmt, 1);
-        message.receiver_id = sqlite3_column_int(stmt, 2);
-        message.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        message.type = Message::string_to_type(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
-        message.is_deleted = sqlite3_column_int(stmt, 6) == 1;
-        message.sender_username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-        messages.push_back(message);
+    return sqlite3_step(stmt.get()) == SQLITE_DONE;
+}
+
+std::vector<std::pair<int, int64_t>> DatabaseManager::get_revocations(int64_t since_ms) {
+    static Histogram& latency = statement_latency("get_revocations");
+    ScopedTimer timer(latency);
+    
+    std::vector<std::pair<int, int64_t>> revocations;
+    
+    auto conn = pool.acquire_reader();
+    ScopedStatement stmt(conn.statement(SQL_GET_REVOCATIONS));
+    
+    if (!stmt) {
+        return revocations;
     }
     
-    sqlite3_finalize(stmt);
+    sqlite3_bind_int64(stmt.get(), 1, static_cast<sqlite3_int64>(since_ms));
     
-    std::reverse(messages.begin(), messages.end());
-    return messages;
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+        revocations.emplace_back(sqlite3_column_int(stmt.get(), 0),
+                                 static_cast<int64_t>(sqlite3_column_int64(stmt.get(), 1)));
+    }
+    
+    return revocations;
 }
 
-bool DatabaseManager::delete_message(int message_id, int user_id) {
-    // 首先检查消息是否属于该用户
-    std::string check_query = "SELECT sender_id, timestamp FROM messages WHERE id = ?";
-    sqlite3_stmt* check_stmt;
-    int rc = sqlite3_prepare_v2(db, check_query.c_str(), -1, &check_stmt, nullptr);
+bool DatabaseManager::delete_revocations_before(int64_t cutoff_ms) {
+    static Histogram& latency = statement_latency("delete_revocations_before");
+    ScopedTimer timer(latency);
     
-    if (rc != SQLITE_OK) {
+    auto conn = pool.acquire_writer();
+    ScopedStatement stmt(conn.statement(SQL_DELETE_REVOCATIONS_BEFORE));
+    
+    if (!stmt) {
         return false;
     }
     
-    sqlite3_bind_int(check_stmt, 1, message_id);
+    sqlite3_bind_int64(stmt.get(), 1, static_cast<sqlite3_int64>(cutoff_ms));
     
-    if (sqlite3_step(check_stmt) != SQLITE_ROW) {
-        sqlite3_finalize(check_stmt);
-        return false;
+    return sqlite3_step(stmt.get()) == SQLITE_DONE;
+}
+
+std::vector<Message> DatabaseManager::get_private_messages(int user1_id, int user2_id, int limit, int before_id) {
+    static Histogram& latency = statement_latency("get_private_messages");
+    ScopedTimer timer(latency);
+    
+    std::vector<Message> messages;
+    
+    auto conn = pool.acquire_reader();
+    ScopedStatement stmt(conn.statement(SQL_GET_PRIVATE_MESSAGES));
+    
+    if (!stmt) {
+        return messages;
     }
     
-    int sender_id = sqlite3_column_int(check_stmt, 0);
-    std::time_t timestamp = sqlite3_column_int64(check_stmt, 1);
-    (void)timestamp; // 避免未使用变量警告
-    sqlite3_finalize(check_stmt);
+    sqlite3_bind_int(stmt.get(), 1, user1_id);
+    sqlite3_bind_int(stmt.get(), 2, user2_id);
+    sqlite3_bind_int(stmt.get(), 3, before_id > 0 ? before_id : INT_MAX);
+    sqlite3_bind_int(stmt.get(), 4, limit);
+    
+    read_messages(stmt.get(), messages);
+    
+    std::reverse(messages.begin(), messages.end());
+    return messages;
+}
+
+bool DatabaseManager::delete_message(int message_id, int user_id, std::string* room_id) {
+    static Histogram& latency = statement_latency("delete_message");
+    ScopedTimer timer(latency);
+    
+    // 检查与更新都在写连接上完成，保证一致性
+    auto conn = pool.acquire_writer();
+    
+    // 首先检查消息是否属于该用户
+    int sender_id = 0;
+    {
+        ScopedStatement check_stmt(conn.statement(SQL_GET_MESSAGE_OWNER));
+        
+        if (!check_stmt) {
+            return false;
+        }
+        
+        sqlite3_bind_int(check_stmt.get(), 1, message_id);
+        
+        if (sqlite3_step(check_stmt.get()) != SQLITE_ROW) {
+            return false;
+        }
+        
+        sender_id = sqlite3_column_int(check_stmt.get(), 0);
+        if (room_id) {
+            *room_id = reinterpret_cast<const char*>(sqlite3_column_text(check_stmt.get(), 1));
+        }
+    }
     
     // 检查是否是消息发送者
     if (sender_id != user_id) {
@@ -375,77 +729,96 @@ bool DatabaseManager::delete_message(int message_id, int user_id) {
     // 检查是否在2分钟内（暂时跳过时间检查，因为时间戳格式问题）
     
     // 标记消息为已删除
-    std::string update_query = "UPDATE messages SET is_deleted = 1 WHERE id = ?";
-    sqlite3_stmt* update_stmt;
-    rc = sqlite3_prepare_v2(db, update_query.c_str(), -1, &update_stmt, nullptr);
+    ScopedStatement update_stmt(conn.statement(SQL_MARK_MESSAGE_DELETED));
     
-    if (rc != SQLITE_OK) {
+    if (!update_stmt) {
         return false;
     }
     
-    sqlite3_bind_int(update_stmt, 1, message_id);
-    rc = sqlite3_step(update_stmt);
-    sqlite3_finalize(update_stmt);
-    
-    return rc == SQLITE_DONE;
+    sqlite3_bind_int(update_stmt.get(), 1, message_id);
+    return sqlite3_step(update_stmt.get()) == SQLITE_DONE;
 }
 
 bool DatabaseManager::mark_message_as_read(int message_id, int user_id) {
-    std::string query = "INSERT OR REPLACE INTO message_read_status (message_id, user_id) VALUES (?, ?)";
+    static Histogram& latency = statement_latency("mark_message_as_read");
+    ScopedTimer timer(latency);
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_writer();
+    ScopedStatement stmt(conn.statement(SQL_MARK_MESSAGE_READ));
     
-    if (rc != SQLITE_OK) {
+    if (!stmt) {
         return false;
     }
     
-    sqlite3_bind_int(stmt, 1, message_id);
-    sqlite3_bind_int(stmt, 2, user_id);
+    sqlite3_bind_int(stmt.get(), 1, message_id);
+    sqlite3_bind_int(stmt.get(), 2, user_id);
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    
-    return rc == SQLITE_DONE;
+    return sqlite3_step(stmt.get()) == SQLITE_DONE;
 }
 
 std::vector<User> DatabaseManager::get_online_users() {
+    static Histogram& latency = statement_latency("get_online_users");
+    ScopedTimer timer(latency);
+    
     std::vector<User> users;
-    std::string query = "SELECT id, username, password_hash, email, status, created_at, last_seen FROM users WHERE status != 'OFFLINE'";
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
+    auto conn = pool.acquire_reader();
+    ScopedStatement stmt(conn.statement(SQL_GET_ONLINE_USERS));
     
-    if (rc != SQLITE_OK) {
+    if (!stmt) {
         return users;
     }
     
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
         User user;
-        user.id = sqlite3_column_int(stmt, 0);
-        user.username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        user.password_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        user.email = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        user.status = User::string_to_status(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
+        user.id = sqlite3_column_int(stmt.get(), 0);
+        user.username = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
+        user.password_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 2));
+        user.email = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 3));
+        user.status = User::string_to_status(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 4)));
         users.push_back(user);
     }
     
-    sqlite3_finalize(stmt);
     return users;
 }
 
 bool DatabaseManager::cleanup_old_messages() {
+    static Histogram& latency = statement_latency("cleanup_old_messages");
+    ScopedTimer timer(latency);
+    
     // 删除3天前的消息
     std::string query = "DELETE FROM messages WHERE timestamp < datetime('now', '-3 days')";
-    return execute_query(query);
+    
+    auto conn = pool.acquire_writer();
+    return execute_query(conn.handle(), query);
 }
 
-bool DatabaseManager::execute_query(const std::string& query) {
+void DatabaseManager::read_messages(sqlite3_stmt* stmt, std::vector<Message>& messages) {
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Message message;
+        message.id = sqlite3_column_int(stmt, 0);
+        message.sender_id = sqlite3_column_int(stmt, 1);
+        message.receiver_id = sqlite3_column_int(stmt, 2);
+        message.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        message.type = Message::string_to_type(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
+        message.timestamp = static_cast<std::time_t>(sqlite3_column_int64(stmt, 5));
+        message.is_deleted = sqlite3_column_int(stmt, 6) == 1;
+        message.sender_username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
+        message.room_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
+        messages.push_back(std::move(message));
+    }
+}
+
+bool DatabaseManager::execute_query(sqlite3* handle, const std::string& query) {
+    if (!handle) {
+        return false;
+    }
+    
     char* err_msg = nullptr;
-    int rc = sqlite3_exec(db, query.c_str(), nullptr, nullptr, &err_msg);
+    int rc = sqlite3_exec(handle, query.c_str(), nullptr, nullptr, &err_msg);
     
     if (rc != SQLITE_OK) {
-        std::cerr << "SQL error: " << err_msg << std::endl;
+        Logger::error("SQL error", {{"error", err_msg ? err_msg : "unknown"}});
         sqlite3_free(err_msg);
         return false;
     }
@@ -0,0 +1,55 @@
+#include "../include/database/statement_cache.h"
+#include "../include/utils/logger.h"
+
+StatementCache::~StatementCache() {
+    clear();
+}
+
+void StatementCache::set_database(sqlite3* handle) {
+    clear();
+    db = handle;
+}
+
+bool StatementCache::prepare_all(const std::vector<std::string>& queries) {
+    for (const auto& query : queries) {
+        if (!get(query)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+sqlite3_stmt* StatementCache::get(const std::string& query) {
+    auto it = statements.find(query);
+    if (it != statements.end()) {
+        return it->second;
+    }
+    
+    if (!db) {
+        return nullptr;
+    }
+    
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v3(db, query.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        Logger::error("SQL prepare error", {{"error", sqlite3_errmsg(db)}});
+        return nullptr;
+    }
+    
+    statements.emplace(query, stmt);
+    return stmt;
+}
+
+void StatementCache::clear() {
+    for (auto& pair : statements) {
+        sqlite3_finalize(pair.second);
+    }
+    statements.clear();
+}
+
+ScopedStatement::~ScopedStatement() {
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+}
@@ -0,0 +1,167 @@
+#include "../include/handlers/binary_codec.h"
+#include "../include/handlers/inbound_json.h"
+#include <climits>
+
+namespace {
+
+// 读取不超过INT_MAX的整数字段
+bool get_int(const char*& pos, const char* end, int& value) {
+    uint64_t raw = 0;
+    if (!BinaryCodec::get_varint(pos, end, raw) || raw > static_cast<uint64_t>(INT_MAX)) {
+        return false;
+    }
+    value = static_cast<int>(raw);
+    return true;
+}
+
+constexpr std::string_view status_names[] = {"ONLINE", "BUSY", "OFFLINE"};
+
+} // namespace
+
+bool BinaryCodec::decode(const std::string& data, InboundMessage& out) {
+    if (data.empty()) {
+        return false;
+    }
+
+    const char* pos = data.data() + 1;
+    const char* end = data.data() + data.size();
+
+    switch (static_cast<uint8_t>(data[0])) {
+        case OP_AUTH:
+            out.type = InboundType::AUTH;
+            out.binary_protocol = true;
+            if (!get_string(pos, end, out.token)) return false;
+            if (pos < end && !get_int(pos, end, out.last_message_id)) return false;
+            if (pos < end) {
+                int flags = 0;
+                if (!get_int(pos, end, flags)) return false;
+                out.deflate = (flags & 0x01) != 0;
+            }
+            break;
+        case OP_CHAT:
+            out.type = InboundType::CHAT;
+            if (!get_string(pos, end, out.content)) return false;
+            if (pos < end && !get_string(pos, end, out.room)) return false;
+            break;
+        case OP_PRIVATE:
+            out.type = InboundType::PRIVATE;
+            if (!get_int(pos, end, out.receiver_id) || !get_string(pos, end, out.content)) return false;
+            break;
+        case OP_STATUS: {
+            out.type = InboundType::STATUS;
+            int status = 0;
+            if (!get_int(pos, end, status) || status > 2) return false;
+            out.status = status_names[status];
+            break;
+        }
+        case OP_RECALL:
+            out.type = InboundType::RECALL;
+            if (!get_int(pos, end, out.message_id)) return false;
+            break;
+        case OP_JOIN_ROOM:
+            out.type = InboundType::JOIN_ROOM;
+            if (!get_string(pos, end, out.room)) return false;
+            if (pos < end && !get_int(pos, end, out.last_message_id)) return false;
+            break;
+        case OP_LEAVE_ROOM:
+            out.type = InboundType::LEAVE_ROOM;
+            if (!get_string(pos, end, out.room)) return false;
+            break;
+        default:
+            return false;
+    }
+
+    // 不允许尾随数据
+    return pos == end;
+}
+
+std::string BinaryCodec::encode(const nlohmann::json& frame, const std::string& text) {
+    auto type = frame.find("type");
+    if (type == frame.end() || !type->is_string()) {
+        return encode_envelope(text);
+    }
+
+    try {
+        std::string out;
+        const std::string& name = type->get_ref<const std::string&>();
+
+        if (name == "message") {
+            const auto& message = frame.at("message");
+            out.push_back(static_cast<char>(OP_MESSAGE));
+            put_varint(out, message.at("id").get<uint64_t>());
+            put_varint(out, message.at("sender_id").get<uint64_t>());
+            put_varint(out, message.at("timestamp").get<uint64_t>());
+            put_string(out, message.at("sender_username").get_ref<const std::string&>());
+            put_string(out, message.at("content").get_ref<const std::string&>());
+            put_string(out, message.value("room", std::string()));
+            return out;
+        }
+
+        if (name == "private_message") {
+            const auto& message = frame.at("message");
+            out.push_back(static_cast<char>(OP_PRIVATE_MESSAGE));
+            put_varint(out, message.at("id").get<uint64_t>());
+            put_varint(out, message.at("sender_id").get<uint64_t>());
+            put_varint(out, message.at("receiver_id").get<uint64_t>());
+            put_varint(out, message.at("timestamp").get<uint64_t>());
+            put_string(out, message.at("sender_username").get_ref<const std::string&>());
+            put_string(out, message.at("content").get_ref<const std::string&>());
+            return out;
+        }
+
+        if (name == "message_recalled") {
+            out.push_back(static_cast<char>(OP_RECALLED));
+            put_varint(out, frame.at("message_id").get<uint64_t>());
+            put_string(out, frame.value("room", std::string()));
+            return out;
+        }
+    } catch (const nlohmann::json::exception&) {
+        // 字段不符合专用格式，退回JSON信封
+    }
+
+    return encode_envelope(text);
+}
+
+std::string BinaryCodec::encode_envelope(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() + 6);
+    out.push_back(static_cast<char>(OP_JSON));
+    put_string(out, text);
+    return out;
+}
+
+void BinaryCodec::put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void BinaryCodec::put_string(std::string& out, const std::string& value) {
+    put_varint(out, value.size());
+    out.append(value);
+}
+
+bool BinaryCodec::get_varint(const char*& pos, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*pos++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BinaryCodec::get_string(const char*& pos, const char* end, std::string_view& value) {
+    uint64_t length = 0;
+    if (!get_varint(pos, end, length) || length > static_cast<uint64_t>(end - pos)) {
+        return false;
+    }
+    value = std::string_view(pos, static_cast<size_t>(length));
+    pos += length;
+    // 与JSON路径一致地拒绝非法UTF-8，否则消息落盘后每次序列化都会抛出异常
+    return InboundJson::is_valid_utf8(value);
+}
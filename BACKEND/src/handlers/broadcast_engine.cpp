@@ -0,0 +1,474 @@
+#include "../include/handlers/broadcast_engine.h"
+#include "../include/models/message.h"
+#include "../include/utils/logger.h"
+#include "../include/utils/metrics.h"
+#include <algorithm>
+#include <functional>
+
+BroadcastEngine::BroadcastEngine(size_t shard_count, size_t ring_capacity, OutboundQueue::Limits limits)
+    : limits(limits), ring(ring_capacity > 0 ? ring_capacity : 1) {
+    if (shard_count == 0) {
+        shard_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+
+    for (auto& shard : shards) {
+        Shard* s = shard.get();
+        s->worker = std::thread([this, s]() { run_shard(*s); });
+    }
+}
+
+BroadcastEngine::~BroadcastEngine() {
+    running = false;
+    for (auto& shard : shards) {
+        {
+            std::lock_guard<std::mutex> lock(shard->wake_mutex);
+        }
+        shard->wake_cv.notify_all();
+    }
+    for (auto& shard : shards) {
+        if (shard->worker.joinable()) {
+            shard->worker.join();
+        }
+    }
+}
+
+void BroadcastEngine::add_connection(crow::websocket::connection* conn, int user_id) {
+    Shard& shard = shard_for(conn);
+    std::lock_guard<std::mutex> lock(shard.connections_mutex);
+    remove_locked(shard, conn);
+    shard.connections.try_emplace(conn, user_id, limits);
+}
+
+void BroadcastEngine::remove_connection(crow::websocket::connection* conn) {
+    Shard& shard = shard_for(conn);
+    // 若分片正在发送，这里会等待发送结束，之后连接不会再被访问
+    std::lock_guard<std::mutex> lock(shard.connections_mutex);
+    remove_locked(shard, conn);
+}
+
+BroadcastEngine::JoinResult BroadcastEngine::join_room(crow::websocket::connection* conn, const std::string& room) {
+    // 非法房间名不分配句柄
+    if (!Message::is_valid_room_name(room)) {
+        return JoinResult::INVALID_ROOM;
+    }
+
+    RoomHandle handle = acquire_room(room);
+    Shard& shard = shard_for(conn);
+    std::lock_guard<std::mutex> lock(shard.connections_mutex);
+
+    auto it = shard.connections.find(conn);
+    if (it == shard.connections.end()) {
+        release_room(handle);
+        return JoinResult::NOT_REGISTERED;
+    }
+
+    ConnectionState& state = it->second;
+    if (std::find(state.rooms.begin(), state.rooms.end(), handle) != state.rooms.end()) {
+        release_room(handle);
+        return JoinResult::JOINED;
+    }
+    if (state.rooms.size() >= MAX_ROOMS_PER_CONNECTION) {
+        release_room(handle);
+        return JoinResult::TOO_MANY_ROOMS;
+    }
+
+    state.rooms.push_back(handle);
+    shard.room_members[handle][conn] = &state;
+    return JoinResult::JOINED;
+}
+
+bool BroadcastEngine::leave_room(crow::websocket::connection* conn, const std::string& room) {
+    RoomHandle handle = room_handle(room);
+    if (handle == GLOBAL_ROOM) return false;
+
+    Shard& shard = shard_for(conn);
+    std::lock_guard<std::mutex> lock(shard.connections_mutex);
+
+    auto it = shard.connections.find(conn);
+    if (it == shard.connections.end()) {
+        return false;
+    }
+
+    auto& rooms = it->second.rooms;
+    auto room_it = std::find(rooms.begin(), rooms.end(), handle);
+    if (room_it == rooms.end()) {
+        return false;
+    }
+
+    rooms.erase(room_it);
+    auto members = shard.room_members.find(handle);
+    if (members != shard.room_members.end()) {
+        members->second.erase(conn);
+        if (members->second.empty()) {
+            shard.room_members.erase(members);
+        }
+    }
+    release_room(handle);
+    return true;
+}
+
+bool BroadcastEngine::in_room(crow::websocket::connection* conn, const std::string& room) {
+    RoomHandle handle = room_handle(room);
+    if (handle == GLOBAL_ROOM) return false;
+
+    Shard& shard = shard_for(conn);
+    std::lock_guard<std::mutex> lock(shard.connections_mutex);
+
+    auto it = shard.connections.find(conn);
+    return it != shard.connections.end() &&
+           std::find(it->second.rooms.begin(), it->second.rooms.end(), handle) != it->second.rooms.end();
+}
+
+bool BroadcastEngine::set_protocol(crow::websocket::connection* conn, bool binary, bool deflate) {
+    Shard& shard = shard_for(conn);
+    std::lock_guard<std::mutex> lock(shard.connections_mutex);
+
+    auto it = shard.connections.find(conn);
+    if (it == shard.connections.end()) {
+        return false;
+    }
+    it->second.binary = binary;
+    it->second.deflate = deflate;
+    it->second.queue.set_encoding(binary, deflate);
+    return true;
+}
+
+void BroadcastEngine::publish(SharedFrame payload, int exclude_user_id, const std::string& room,
+                              UserList skip_users) {
+    if (!payload) return;
+
+    RoomHandle handle = GLOBAL_ROOM;
+    if (!room.empty()) {
+        handle = room_handle(room);
+        if (handle == GLOBAL_ROOM) {
+            // 房间当前没有订阅者
+            return;
+        }
+    }
+
+    uint64_t seq = head.fetch_add(1);
+    Slot& slot = ring[seq % ring.size()];
+
+    // 顺序锁：先标记写入中，写完后发布序号
+    slot.sequence.store(SLOT_WRITING);
+    std::atomic_store(&slot.payload, std::move(payload));
+    std::atomic_store(&slot.skip_users, std::move(skip_users));
+    slot.exclude_user_id.store(exclude_user_id);
+    slot.room.store(handle);
+    slot.published_at.store(std::chrono::steady_clock::now().time_since_epoch().count());
+    slot.sequence.store(seq);
+
+    for (auto& shard : shards) {
+        wake(*shard);
+    }
+}
+
+bool BroadcastEngine::send_to(crow::websocket::connection* conn, const SharedFrame& payload) {
+    if (!conn || !payload) return false;
+
+    Shard& shard = shard_for(conn);
+    bool backlogged = false;
+    {
+        std::lock_guard<std::mutex> lock(shard.connections_mutex);
+        auto it = shard.connections.find(conn);
+        if (it == shard.connections.end()) {
+            return false;
+        }
+
+        enqueue_locked(it->second, payload);
+        backlogged = flush_locked(conn, it->second, OutboundQueue::Clock::now());
+        if (backlogged) {
+            shard.backlog.insert(conn);
+        }
+    }
+
+    // 积压的帧和慢消费者的关闭都交给分片线程处理
+    if (backlogged && !shard.backlogged.exchange(true)) {
+        wake(shard);
+    }
+    return true;
+}
+
+size_t BroadcastEngine::get_connection_count() const {
+    size_t count = 0;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->connections_mutex);
+        count += shard->connections.size();
+    }
+    return count;
+}
+
+BroadcastEngine::QueueStats BroadcastEngine::get_queue_stats() const {
+    QueueStats stats;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->connections_mutex);
+        for (const auto& pair : shard->connections) {
+            stats.frames += pair.second.queue.size();
+            stats.bytes += pair.second.queue.bytes();
+        }
+        stats.backlogged_connections += shard->backlog.size();
+    }
+    return stats;
+}
+
+size_t BroadcastEngine::get_room_count() const {
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    return room_handles.size();
+}
+
+BroadcastEngine::RoomHandle BroadcastEngine::room_handle(const std::string& room) {
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    auto it = room_handles.find(room);
+    return it != room_handles.end() ? it->second.handle : GLOBAL_ROOM;
+}
+
+BroadcastEngine::RoomHandle BroadcastEngine::acquire_room(const std::string& room) {
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+
+    auto result = room_handles.try_emplace(room, RoomEntry{next_room_handle, 0});
+    if (result.second) {
+        room_names.emplace(next_room_handle++, room);
+    }
+    ++result.first->second.subscribers;
+    return result.first->second.handle;
+}
+
+void BroadcastEngine::release_room(RoomHandle handle) {
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+
+    auto name = room_names.find(handle);
+    if (name == room_names.end()) {
+        return;
+    }
+    auto it = room_handles.find(name->second);
+    if (it != room_handles.end() && --it->second.subscribers == 0) {
+        room_handles.erase(it);
+        room_names.erase(name);
+    }
+}
+
+BroadcastEngine::Shard& BroadcastEngine::shard_for(crow::websocket::connection* conn) {
+    size_t index = std::hash<crow::websocket::connection*>()(conn) % shards.size();
+    return *shards[index];
+}
+
+void BroadcastEngine::wake(Shard& shard) {
+    std::lock_guard<std::mutex> lock(shard.wake_mutex);
+    shard.wake_cv.notify_one();
+}
+
+void BroadcastEngine::run_shard(Shard& shard) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(shard.wake_mutex);
+            auto ready = [this, &shard]() {
+                return !running || head.load() > shard.cursor;
+            };
+            if (shard.backlogged.load()) {
+                // 积压的队列按漏桶速率逐步发出，定时重试
+                shard.wake_cv.wait_for(lock, BACKLOG_RETRY_INTERVAL, ready);
+            } else {
+                shard.wake_cv.wait(lock, [&]() { return ready() || shard.backlogged.load(); });
+            }
+        }
+
+        if (!running) break;
+        drain_shard(shard);
+    }
+}
+
+void BroadcastEngine::drain_shard(Shard& shard) {
+    static Histogram& lag = Metrics::instance().histogram(
+        "chatroom_broadcast_lag_seconds", "Delay from publish until a shard worker fans the message out");
+    static Histogram& fanout = Metrics::instance().histogram(
+        "chatroom_broadcast_fanout_recipients", "Recipients per broadcast message per shard", "",
+        Metrics::Unit::COUNT);
+    static Counter& deliveries = Metrics::instance().counter(
+        "chatroom_broadcast_deliveries_total", "Frames queued to connections by broadcasts");
+
+    uint64_t end = head.load();
+
+    // 分片落后超过环形缓冲区容量，跳过已被覆盖的消息
+    if (end - shard.cursor > ring.size()) {
+        uint64_t skipped = end - ring.size() - shard.cursor;
+        dropped.fetch_add(skipped, std::memory_order_relaxed);
+        shard.cursor = end - ring.size();
+        Logger::warn("Broadcast shard lagged", {{"dropped", skipped}});
+    }
+
+    struct Pending {
+        SharedFrame payload;
+        int exclude_user_id;
+        RoomHandle room;
+        UserList skip_users;
+
+        bool delivers_to(int user_id) const {
+            return user_id != exclude_user_id &&
+                   !(skip_users && std::binary_search(skip_users->begin(), skip_users->end(), user_id));
+        }
+    };
+    std::vector<Pending> batch;
+    while (shard.cursor < end) {
+        Slot& slot = ring[shard.cursor % ring.size()];
+        uint64_t seq = slot.sequence.load();
+
+        if (seq != shard.cursor) {
+            if (seq != SLOT_WRITING && seq > shard.cursor) {
+                // 已被后续消息覆盖
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                ++shard.cursor;
+                continue;
+            }
+            // 生产者尚未写完，稍后重试
+            std::this_thread::yield();
+            break;
+        }
+
+        SharedFrame payload = std::atomic_load(&slot.payload);
+        UserList skip_users = std::atomic_load(&slot.skip_users);
+        int exclude_user_id = slot.exclude_user_id.load();
+        RoomHandle room = slot.room.load();
+        int64_t published_at = slot.published_at.load();
+
+        if (slot.sequence.load() != seq) {
+            // 读取期间被覆盖
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            ++shard.cursor;
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        lag.observe(static_cast<uint64_t>(std::max<int64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                now - std::chrono::steady_clock::duration(published_at)).count(), 0)));
+
+        batch.push_back({std::move(payload), exclude_user_id, room, std::move(skip_users)});
+        ++shard.cursor;
+    }
+
+    if (batch.empty() && !shard.backlogged.load()) return;
+
+    std::lock_guard<std::mutex> lock(shard.connections_mutex);
+
+    // 只处理本轮收到帧的连接和此前积压的连接
+    std::vector<std::pair<crow::websocket::connection*, ConnectionState*>> touched;
+    auto schedule = [&touched](crow::websocket::connection* conn, ConnectionState& state) {
+        if (!state.scheduled) {
+            state.scheduled = true;
+            touched.emplace_back(conn, &state);
+        }
+    };
+
+    for (auto* conn : shard.backlog) {
+        auto it = shard.connections.find(conn);
+        if (it != shard.connections.end()) {
+            schedule(conn, it->second);
+        }
+    }
+
+    for (const auto& entry : batch) {
+        uint64_t recipients = 0;
+        if (entry.room == GLOBAL_ROOM) {
+            for (auto& pair : shard.connections) {
+                if (entry.delivers_to(pair.second.user_id)) {
+                    enqueue_locked(pair.second, entry.payload);
+                    schedule(pair.first, pair.second);
+                    ++recipients;
+                }
+            }
+        } else {
+            auto members = shard.room_members.find(entry.room);
+            if (members != shard.room_members.end()) {
+                for (auto& member : members->second) {
+                    if (entry.delivers_to(member.second->user_id)) {
+                        enqueue_locked(*member.second, entry.payload);
+                        schedule(member.first, *member.second);
+                        ++recipients;
+                    }
+                }
+            }
+        }
+        fanout.observe(recipients);
+        deliveries.inc(recipients);
+    }
+
+    auto now = OutboundQueue::Clock::now();
+    for (auto& pair : touched) {
+        crow::websocket::connection* conn = pair.first;
+        ConnectionState& state = *pair.second;
+        state.scheduled = false;
+
+        if (state.closing) {
+            // 只在分片线程中关闭连接，避免在IO线程内同步触发关闭回调
+            if (!state.close_sent) {
+                state.close_sent = true;
+                slow_consumer_disconnects.fetch_add(1, std::memory_order_relaxed);
+                Logger::warn("Disconnecting slow consumer", {{"user_id", state.user_id}});
+                conn->close("Slow consumer");
+            }
+            shard.backlog.erase(conn);
+            continue;
+        }
+
+        if (flush_locked(conn, state, now)) {
+            shard.backlog.insert(conn);
+        } else {
+            shard.backlog.erase(conn);
+        }
+    }
+    shard.backlogged.store(!shard.backlog.empty());
+}
+
+void BroadcastEngine::remove_locked(Shard& shard, crow::websocket::connection* conn) {
+    auto it = shard.connections.find(conn);
+    if (it == shard.connections.end()) {
+        return;
+    }
+
+    for (RoomHandle handle : it->second.rooms) {
+        auto members = shard.room_members.find(handle);
+        if (members != shard.room_members.end()) {
+            members->second.erase(conn);
+            if (members->second.empty()) {
+                shard.room_members.erase(members);
+            }
+        }
+        release_room(handle);
+    }
+    shard.backlog.erase(conn);
+    shard.connections.erase(it);
+}
+
+void BroadcastEngine::enqueue_locked(ConnectionState& state, const SharedFrame& payload) {
+    if (state.closing) return;
+
+    uint64_t dropped_before = state.queue.get_dropped_count();
+    auto result = state.queue.push(payload);
+
+    if (result == OutboundQueue::PushResult::DROPPED) {
+        slow_consumer_drops.fetch_add(state.queue.get_dropped_count() - dropped_before,
+                                      std::memory_order_relaxed);
+    } else if (result == OutboundQueue::PushResult::OVERFLOW) {
+        state.closing = true;
+    }
+}
+
+bool BroadcastEngine::flush_locked(crow::websocket::connection* conn, ConnectionState& state,
+                                   OutboundQueue::Clock::time_point now) {
+    if (state.closing) return true;
+
+    while (SharedFrame frame = state.queue.pop_ready(now)) {
+        bool binary_frame = false;
+        const std::string& data = frame->encoded(state.binary, state.deflate, &binary_frame);
+        if (binary_frame) {
+            conn->send_binary(data);
+        } else {
+            conn->send_text(data);
+        }
+    }
+    return !state.queue.empty();
+}
@@ -0,0 +1,413 @@
+#include "../include/handlers/inbound_json.h"
+#include <climits>
+#include <cstdint>
+
+namespace {
+
+// 嵌套的未知字段最大深度，防止恶意帧耗尽栈
+constexpr int MAX_DEPTH = 32;
+
+// 帧中出现的已知字段
+struct Fields {
+    std::string_view type;
+    std::string_view token;
+    std::string_view content;
+    std::string_view message;
+    std::string_view room;
+    std::string_view status;
+    std::string_view protocol;
+    std::string_view compression;
+    bool has_type = false;
+    bool has_token = false;
+    bool has_content = false;
+    bool has_message = false;
+    bool has_room = false;
+    bool has_status = false;
+    int receiver_id = 0;
+    int message_id = 0;
+    int last_message_id = 0;
+    bool has_receiver_id = false;
+    bool has_message_id = false;
+};
+
+// 合法UTF-8序列的长度（RFC 3629：拒绝过长编码、代理区和超过U+10FFFF的码点），非法时返回0
+int utf8_length(const char* pos, const char* end) {
+    uint8_t lead = static_cast<uint8_t>(pos[0]);
+    int length;
+    uint8_t min = 0x80, max = 0xBF;
+
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) min = 0xA0;
+        if (lead == 0xED) max = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) min = 0x90;
+        if (lead == 0xF4) max = 0x8F;
+    } else {
+        return 0;
+    }
+
+    if (end - pos < length) return 0;
+    uint8_t second = static_cast<uint8_t>(pos[1]);
+    if (second < min || second > max) return 0;
+    for (int i = 2; i < length; ++i) {
+        uint8_t next = static_cast<uint8_t>(pos[i]);
+        if (next < 0x80 || next > 0xBF) return 0;
+    }
+    return length;
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void append_utf8(std::string& out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        out.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+}
+
+class Scanner {
+public:
+    Scanner(std::string_view data, std::string& storage)
+        : pos(data.data()), end(data.data() + data.size()), data_size(data.size()), storage(storage) {}
+
+    bool parse(Fields& fields) {
+        skip_whitespace();
+        if (!consume('{')) return false;
+        skip_whitespace();
+        if (!consume('}')) {
+            do {
+                skip_whitespace();
+                std::string_view key;
+                if (!parse_string(&key)) return false;
+                skip_whitespace();
+                if (!consume(':')) return false;
+                skip_whitespace();
+                if (!parse_field(key, fields)) return false;
+                skip_whitespace();
+            } while (consume(','));
+            if (!consume('}')) return false;
+        }
+        skip_whitespace();
+        return pos == end;
+    }
+
+private:
+    const char* pos;
+    const char* end;
+    size_t data_size;
+    std::string& storage;
+
+    bool consume(char c) {
+        if (pos < end && *pos == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    void skip_whitespace() {
+        while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) {
+            ++pos;
+        }
+    }
+
+    bool parse_field(std::string_view key, Fields& fields) {
+        if (key == "type") return fields.has_type = parse_string(&fields.type);
+        if (key == "token") return fields.has_token = parse_string(&fields.token);
+        if (key == "content") return fields.has_content = parse_string(&fields.content);
+        if (key == "message") return fields.has_message = parse_string(&fields.message);
+        if (key == "room") return fields.has_room = parse_string(&fields.room);
+        if (key == "status") return fields.has_status = parse_string(&fields.status);
+        if (key == "protocol") return parse_string(&fields.protocol);
+        if (key == "compression") return parse_string(&fields.compression);
+        if (key == "receiver_id") return fields.has_receiver_id = parse_int(fields.receiver_id);
+        if (key == "message_id") return fields.has_message_id = parse_int(fields.message_id);
+        if (key == "last_message_id") return parse_int(fields.last_message_id);
+        return skip_value(0);
+    }
+
+    // 解析字符串；value为空时只校验。无转义时返回帧数据的视图，否则解码到storage
+    bool parse_string(std::string_view* value) {
+        if (!consume('"')) return false;
+        const char* start = pos;
+
+        // 快速路径：扫描到结束引号或第一个转义
+        while (pos < end) {
+            uint8_t c = static_cast<uint8_t>(*pos);
+            if (c == '"') {
+                if (value) *value = std::string_view(start, static_cast<size_t>(pos - start));
+                ++pos;
+                return true;
+            }
+            if (c == '\\') break;
+            if (c < 0x20) return false;
+            if (c < 0x80) {
+                ++pos;
+            } else {
+                int length = utf8_length(pos, end);
+                if (length == 0) return false;
+                pos += length;
+            }
+        }
+        if (pos == end) return false;
+
+        // 慢速路径：解码结果不长于原文，storage按帧大小预留一次后不会重新分配，已有视图保持有效
+        if (value && storage.capacity() < data_size) {
+            storage.reserve(data_size);
+        }
+        size_t offset = storage.size();
+        if (value) storage.append(start, static_cast<size_t>(pos - start));
+
+        while (pos < end) {
+            uint8_t c = static_cast<uint8_t>(*pos);
+            if (c == '"') {
+                ++pos;
+                if (value) *value = std::string_view(storage.data() + offset, storage.size() - offset);
+                return true;
+            }
+            if (c < 0x20) return false;
+
+            if (c == '\\') {
+                if (!parse_escape(value != nullptr)) return false;
+            } else if (c < 0x80) {
+                if (value) storage.push_back(static_cast<char>(c));
+                ++pos;
+            } else {
+                int length = utf8_length(pos, end);
+                if (length == 0) return false;
+                if (value) storage.append(pos, static_cast<size_t>(length));
+                pos += length;
+            }
+        }
+        return false;
+    }
+
+    bool parse_escape(bool decode) {
+        ++pos; // 反斜杠
+        if (pos == end) return false;
+
+        char escaped = *pos++;
+        char plain;
+        switch (escaped) {
+            case '"': plain = '"'; break;
+            case '\\': plain = '\\'; break;
+            case '/': plain = '/'; break;
+            case 'b': plain = '\b'; break;
+            case 'f': plain = '\f'; break;
+            case 'n': plain = '\n'; break;
+            case 'r': plain = '\r'; break;
+            case 't': plain = '\t'; break;
+            case 'u': {
+                uint32_t code_point = 0;
+                if (!parse_hex4(code_point)) return false;
+
+                if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                    // 高代理项必须紧跟低代理项
+                    uint32_t low = 0;
+                    if (end - pos < 2 || pos[0] != '\\' || pos[1] != 'u') return false;
+                    pos += 2;
+                    if (!parse_hex4(low) || low < 0xDC00 || low > 0xDFFF) return false;
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+                    return false;
+                }
+
+                if (decode) append_utf8(storage, code_point);
+                return true;
+            }
+            default:
+                return false;
+        }
+
+        if (decode) storage.push_back(plain);
+        return true;
+    }
+
+    bool parse_hex4(uint32_t& value) {
+        if (end - pos < 4) return false;
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            int digit = hex_value(*pos++);
+            if (digit < 0) return false;
+            value = (value << 4) | static_cast<uint32_t>(digit);
+        }
+        return true;
+    }
+
+    // 整数字段：不接受小数、指数或超出int范围的值
+    bool parse_int(int& value) {
+        bool negative = consume('-');
+        if (pos == end || *pos < '0' || *pos > '9') return false;
+        if (*pos == '0' && end - pos > 1 && pos[1] >= '0' && pos[1] <= '9') return false;
+
+        int64_t result = 0;
+        while (pos < end && *pos >= '0' && *pos <= '9') {
+            result = result * 10 + (*pos++ - '0');
+            if (result > static_cast<int64_t>(INT_MAX) + 1) return false;
+        }
+        if (pos < end && (*pos == '.' || *pos == 'e' || *pos == 'E')) return false;
+
+        if (negative) result = -result;
+        if (result > INT_MAX || result < INT_MIN) return false;
+        value = static_cast<int>(result);
+        return true;
+    }
+
+    bool skip_digits() {
+        const char* start = pos;
+        while (pos < end && *pos >= '0' && *pos <= '9') ++pos;
+        return pos != start;
+    }
+
+    bool skip_number() {
+        consume('-');
+        if (consume('0')) {
+            // 前导零后不能再跟数字
+        } else if (!skip_digits()) {
+            return false;
+        }
+        if (consume('.') && !skip_digits()) return false;
+        if (consume('e') || consume('E')) {
+            if (!consume('+')) consume('-');
+            if (!skip_digits()) return false;
+        }
+        return true;
+    }
+
+    bool skip_literal(std::string_view literal) {
+        if (static_cast<size_t>(end - pos) < literal.size() ||
+            std::string_view(pos, literal.size()) != literal) {
+            return false;
+        }
+        pos += literal.size();
+        return true;
+    }
+
+    // 校验并跳过未知字段的值
+    bool skip_value(int depth) {
+        if (pos == end) return false;
+
+        switch (*pos) {
+            case '"':
+                return parse_string(nullptr);
+            case 't':
+                return skip_literal("true");
+            case 'f':
+                return skip_literal("false");
+            case 'n':
+                return skip_literal("null");
+            case '{':
+            case '[': {
+                if (depth >= MAX_DEPTH) return false;
+                bool object = *pos == '{';
+                char close = object ? '}' : ']';
+                ++pos;
+                skip_whitespace();
+                if (consume(close)) return true;
+                do {
+                    skip_whitespace();
+                    if (object) {
+                        if (!parse_string(nullptr)) return false;
+                        skip_whitespace();
+                        if (!consume(':')) return false;
+                        skip_whitespace();
+                    }
+                    if (!skip_value(depth + 1)) return false;
+                    skip_whitespace();
+                } while (consume(','));
+                return consume(close);
+            }
+            default:
+                return skip_number();
+        }
+    }
+};
+
+} // namespace
+
+bool InboundJson::decode(std::string_view data, InboundMessage& out) {
+    Fields fields;
+    Scanner scanner(data, out.storage);
+    if (!scanner.parse(fields) || !fields.has_type) {
+        return false;
+    }
+
+    const std::string_view type = fields.type;
+    if (type == "auth") {
+        // 认证消息；重连客户端携带最后收到的消息ID，用于补发断线期间的消息
+        if (!fields.has_token) return false;
+        out.type = InboundType::AUTH;
+        out.token = fields.token;
+        out.last_message_id = fields.last_message_id;
+        out.binary_protocol = fields.protocol == "binary";
+        out.deflate = fields.compression == "deflate";
+    } else if (type == "chat") {
+        // 聊天消息（未指定房间时发往默认房间）
+        if (!fields.has_content && !fields.has_message) return false;
+        out.type = InboundType::CHAT;
+        out.content = fields.has_content ? fields.content : fields.message;
+        out.room = fields.room;
+    } else if (type == "join_room") {
+        // 加入房间，可携带该房间最后收到的消息ID以补发错过的消息
+        if (!fields.has_room) return false;
+        out.type = InboundType::JOIN_ROOM;
+        out.room = fields.room;
+        out.last_message_id = fields.last_message_id;
+    } else if (type == "leave_room") {
+        if (!fields.has_room) return false;
+        out.type = InboundType::LEAVE_ROOM;
+        out.room = fields.room;
+    } else if (type == "private") {
+        if (!fields.has_receiver_id || !fields.has_content) return false;
+        out.type = InboundType::PRIVATE;
+        out.receiver_id = fields.receiver_id;
+        out.content = fields.content;
+    } else if (type == "status") {
+        if (!fields.has_status) return false;
+        out.type = InboundType::STATUS;
+        out.status = fields.status;
+    } else if (type == "recall") {
+        if (!fields.has_message_id) return false;
+        out.type = InboundType::RECALL;
+        out.message_id = fields.message_id;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool InboundJson::is_valid_utf8(std::string_view text) {
+    const char* pos = text.data();
+    const char* end = pos + text.size();
+    while (pos < end) {
+        if (static_cast<uint8_t>(*pos) < 0x80) {
+            ++pos;
+            continue;
+        }
+        int length = utf8_length(pos, end);
+        if (length == 0) return false;
+        pos += length;
+    }
+    return true;
+}
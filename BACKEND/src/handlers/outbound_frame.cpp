@@ -0,0 +1,56 @@
+#include "../include/handlers/outbound_frame.h"
+#include "../include/handlers/binary_codec.h"
+#include "../include/utils/compression_utils.h"
+
+namespace {
+
+// 生成压缩帧；压缩后不更小时返回空串
+std::string build_deflated(const std::string& payload) {
+    if (payload.size() < OutboundFrame::COMPRESSION_THRESHOLD) {
+        return std::string();
+    }
+    
+    std::string compressed;
+    if (!CompressionUtils::deflate_raw(payload, compressed) || compressed.size() + 1 >= payload.size()) {
+        return std::string();
+    }
+    
+    std::string frame;
+    frame.reserve(compressed.size() + 1);
+    frame.push_back(static_cast<char>(BinaryCodec::OP_DEFLATE));
+    frame.append(compressed);
+    return frame;
+}
+
+} // namespace
+
+std::shared_ptr<const OutboundFrame> OutboundFrame::from_json(const nlohmann::json& j,
+                                                              std::string coalesce_key) {
+    std::string text = j.dump();
+    std::string binary = BinaryCodec::encode(j, text);
+    return std::make_shared<const OutboundFrame>(std::move(text), std::move(binary), std::move(coalesce_key));
+}
+
+const std::string& OutboundFrame::deflated_text() const {
+    std::call_once(text_deflate_once, [this]() { deflated_text_payload = build_deflated(payload); });
+    return deflated_text_payload;
+}
+
+const std::string& OutboundFrame::deflated_binary() const {
+    std::call_once(binary_deflate_once, [this]() { deflated_binary_payload = build_deflated(binary_payload); });
+    return deflated_binary_payload;
+}
+
+const std::string& OutboundFrame::encoded(bool binary, bool deflate, bool* binary_frame) const {
+    if (deflate) {
+        // 压缩副本在所有接收者之间共享，只在第一次需要时生成
+        const std::string& compressed = binary ? deflated_binary() : deflated_text();
+        if (!compressed.empty()) {
+            if (binary_frame) *binary_frame = true;
+            return compressed;
+        }
+    }
+    
+    if (binary_frame) *binary_frame = binary;
+    return binary ? binary_payload : payload;
+}
@@ -0,0 +1,117 @@
+#include "../include/handlers/outbound_queue.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+OutboundQueue::Limits OutboundQueue::Limits::from_env() {
+    Limits limits;
+
+    if (const char* policy = std::getenv("CHATROOM_SLOW_CONSUMER_POLICY")) {
+        if (std::string(policy) == "disconnect") {
+            limits.policy = SlowConsumerPolicy::DISCONNECT;
+        }
+    }
+    if (const char* max_messages = std::getenv("CHATROOM_OUTBOUND_MAX_MESSAGES")) {
+        long value = std::strtol(max_messages, nullptr, 10);
+        if (value > 0) limits.max_messages = static_cast<size_t>(value);
+    }
+    if (const char* max_bytes = std::getenv("CHATROOM_OUTBOUND_MAX_BYTES")) {
+        long value = std::strtol(max_bytes, nullptr, 10);
+        if (value > 0) limits.max_bytes = static_cast<size_t>(value);
+    }
+    if (const char* max_inflight = std::getenv("CHATROOM_OUTBOUND_MAX_INFLIGHT_BYTES")) {
+        long value = std::strtol(max_inflight, nullptr, 10);
+        if (value > 0) limits.max_inflight_bytes = static_cast<size_t>(value);
+    }
+    if (const char* drain_rate = std::getenv("CHATROOM_OUTBOUND_DRAIN_RATE")) {
+        long value = std::strtol(drain_rate, nullptr, 10);
+        if (value > 0) limits.assumed_drain_rate = static_cast<size_t>(value);
+    }
+
+    return limits;
+}
+
+OutboundQueue::OutboundQueue(const Limits& limits)
+    : limits(limits), last_drain(Clock::now()) {}
+
+OutboundQueue::PushResult OutboundQueue::push(SharedFrame frame) {
+    if (!frame) return PushResult::QUEUED;
+
+    size_t size = wire_size(frame);
+    PushResult result = PushResult::QUEUED;
+
+    // 尚未发出的同键帧已过时：移除旧帧，新帧照常追加到队尾，不改变与其他帧的先后顺序
+    if (!frame->key().empty()) {
+        for (auto it = frames.begin(); it != frames.end(); ++it) {
+            if ((*it)->key() == frame->key()) {
+                queued_bytes -= wire_size(*it);
+                frames.erase(it);
+                result = PushResult::COALESCED;
+                break;
+            }
+        }
+    }
+
+    bool full = frames.size() >= limits.max_messages ||
+                (!frames.empty() && queued_bytes + size > limits.max_bytes);
+
+    if (full) {
+        if (limits.policy == SlowConsumerPolicy::DISCONNECT) {
+            return PushResult::OVERFLOW;
+        }
+
+        // 丢弃最旧的帧直到放得下（单帧超过字节上限时清空队列后仍然入队）
+        while (!frames.empty() &&
+               (frames.size() >= limits.max_messages ||
+                queued_bytes + size > limits.max_bytes)) {
+            drop_front();
+        }
+        result = PushResult::DROPPED;
+    }
+
+    queued_bytes += size;
+    frames.push_back(std::move(frame));
+    return result;
+}
+
+void OutboundQueue::set_encoding(bool binary_protocol, bool deflate_frames) {
+    binary = binary_protocol;
+    deflate = deflate_frames;
+
+    queued_bytes = 0;
+    for (const auto& frame : frames) {
+        queued_bytes += wire_size(frame);
+    }
+}
+
+SharedFrame OutboundQueue::pop_ready(Clock::time_point now) {
+    // 按假定速率排空漏桶
+    double elapsed = std::chrono::duration<double>(now - last_drain).count();
+    if (elapsed > 0) {
+        inflight_bytes = std::max(0.0, inflight_bytes - elapsed * limits.assumed_drain_rate);
+        last_drain = now;
+    }
+
+    // 预算为空时至少放行一帧，保证大帧也能发出
+    if (frames.empty() ||
+        (inflight_bytes > 0 && inflight_bytes + wire_size(frames.front()) > limits.max_inflight_bytes)) {
+        return nullptr;
+    }
+
+    SharedFrame frame = std::move(frames.front());
+    frames.pop_front();
+    size_t size = wire_size(frame);
+    queued_bytes -= size;
+    inflight_bytes += size;
+    return frame;
+}
+
+void OutboundQueue::drop_front() {
+    queued_bytes -= wire_size(frames.front());
+    frames.pop_front();
+    ++dropped;
+}
+
+size_t OutboundQueue::wire_size(const SharedFrame& frame) const {
+    return frame->encoded(binary, deflate).size();
+}
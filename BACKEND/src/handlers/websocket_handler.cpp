@@ -1,14 +1,72 @@
 #include "../include/handlers/websocket_handler.h"
 #include "../include/services/chat_service.h"
 #include "../include/services/auth_service.h"
+#include "../include/handlers/binary_codec.h"
+#include "../include/handlers/inbound_json.h"
+#include "../include/utils/logger.h"
+#include "../include/utils/metrics.h"
 #include <nlohmann/json.hpp>
-#include <iostream>
 
 using json = nlohmann::json;
 
+namespace {
+
+json presence_user_json(int user_id, const std::string& username, UserStatus status) {
+    return {
+        {"id", user_id},
+        {"username", username},
+        {"status", User::status_to_string(status)}
+    };
+}
+
+json message_to_json(const Message& message) {
+    return {
+        {"id", message.id},
+        {"sender_id", message.sender_id},
+        {"sender_username", message.sender_username},
+        {"content", message.content},
+        {"timestamp", message.timestamp},
+        {"type", Message::type_to_string(message.type)},
+        {"room", message.room_id}
+    };
+}
+
+const char* inbound_type_name(InboundType type) {
+    switch (type) {
+        case InboundType::AUTH: return "auth";
+        case InboundType::CHAT: return "chat";
+        case InboundType::PRIVATE: return "private";
+        case InboundType::STATUS: return "status";
+        case InboundType::RECALL: return "recall";
+        case InboundType::JOIN_ROOM: return "join_room";
+        case InboundType::LEAVE_ROOM: return "leave_room";
+        case InboundType::UNKNOWN: break;
+    }
+    return "unknown";
+}
+
+// 各入站消息类型从收到帧到处理完成（聊天消息即发布到广播环）的耗时
+Histogram& handle_latency(InboundType type) {
+    static Histogram* histograms[] = {
+        &Metrics::instance().histogram("chatroom_ws_message_handle_seconds",
+                                       "Time from receiving a WebSocket frame until it is handled", "type=\"auth\""),
+        &Metrics::instance().histogram("chatroom_ws_message_handle_seconds", "", "type=\"chat\""),
+        &Metrics::instance().histogram("chatroom_ws_message_handle_seconds", "", "type=\"private\""),
+        &Metrics::instance().histogram("chatroom_ws_message_handle_seconds", "", "type=\"status\""),
+        &Metrics::instance().histogram("chatroom_ws_message_handle_seconds", "", "type=\"recall\""),
+        &Metrics::instance().histogram("chatroom_ws_message_handle_seconds", "", "type=\"join_room\""),
+        &Metrics::instance().histogram("chatroom_ws_message_handle_seconds", "", "type=\"leave_room\""),
+    };
+    return *histograms[static_cast<size_t>(type)];
+}
+
+} // namespace
+
 WebSocketHandler::WebSocketHandler(std::shared_ptr<ChatService> chat_service, 
                                  std::shared_ptr<AuthService> auth_service)
-    : chat_service(chat_service), auth_service(auth_service) {}
+    : user_limiter(RateLimiter::Limits::from_env("CHATROOM_RATE_LIMIT_USER", {30, 10.0})),
+      ip_limiter(RateLimiter::Limits::from_env("CHATROOM_RATE_LIMIT_IP", {2000, 200.0})),
+      chat_service(chat_service), auth_service(auth_service) {}
 
 void WebSocketHandler::on_open(crow::websocket::connection& conn) {
     std::lock_guard<std::mutex> lock(clients_mutex);
@@ -16,150 +74,345 @@ void WebSocketHandler::on_open(crow::websocket::connection& conn) {
     clients[&conn]->conn = &conn;
     clients[&conn]->user_id = 0; // 未认证
     clients[&conn]->connected_at = std::time(nullptr);
+    clients[&conn]->ip_key = std::hash<std::string>()(conn.get_remote_ip());
     
-    std::cout << "WebSocket connection opened" << std::endl;
+    Logger::info("WebSocket connection opened", {{"remote_ip", conn.get_remote_ip()}});
 }
 
 void WebSocketHandler::on_close(crow::websocket::connection& conn, const std::string& reason) {
     cleanup_connection(conn);
-    std::cout << "WebSocket connection closed: " << reason << std::endl;
+    Logger::info("WebSocket connection closed", {{"reason", reason}});
 }
 
 void WebSocketHandler::on_message(crow::websocket::connection& conn, const std::string& data, bool is_binary) {
-    if (is_binary) return;
+    static Counter& json_frames = Metrics::instance().counter(
+        "chatroom_ws_frames_total", "Inbound WebSocket frames", "protocol=\"json\"");
+    static Counter& binary_frames = Metrics::instance().counter(
+        "chatroom_ws_frames_total", "", "protocol=\"binary\"");
+    static Counter& malformed_frames = Metrics::instance().counter(
+        "chatroom_ws_malformed_frames_total", "Inbound WebSocket frames that failed to decode");
     
-    std::cout << "Received WebSocket message: " << data << std::endl;
+    auto received_at = std::chrono::steady_clock::now();
+    (is_binary ? binary_frames : json_frames).inc();
     
-    try {
-        json msg = json::parse(data);
-        std::string type = msg["type"];
-        
-        std::cout << "Message type: " << type << std::endl;
-        
-        if (type == "auth") {
-            // 认证消息
-            std::string token = msg["token"];
-            authenticate_connection(conn, token);
-        } else if (type == "chat") {
-            // 聊天消息
-            std::string message_content = msg.contains("content") ? msg["content"] : msg["message"];
-            handle_chat_message(conn, message_content);
-        } else if (type == "private") {
-            // 私聊消息
-            handle_private_message(conn, data);
-        } else if (type == "status") {
-            // 状态更改
-            handle_status_change(conn, msg["status"]);
-        } else if (type == "recall") {
-            // 撤回消息
-            handle_recall_message(conn, msg["message_id"]);
+    // 先限流再解析，超限的帧不进入解析、落盘和广播
+    if (!admit_message(conn)) {
+        static const SharedFrame rate_limited_frame = OutboundFrame::from_json({
+            {"type", "error"},
+            {"code", "rate_limited"},
+            {"message", "Rate limit exceeded"}
+        }, "rate_limited");
+        send_to_connection(&conn, rate_limited_frame);
+        return;
+    }
+    
+    InboundMessage msg;
+    
+    if (is_binary) {
+        // 二进制协议帧
+        if (!BinaryCodec::decode(data, msg)) {
+            malformed_frames.inc();
+            Logger::warn("Malformed binary WebSocket frame", {{"bytes", data.size()}});
+            return;
         }
+    } else {
+        // 单遍解码，不构建JSON DOM
+        if (!InboundJson::decode(data, msg)) {
+            malformed_frames.inc();
+            Logger::warn("Malformed JSON WebSocket frame", {{"bytes", data.size()}});
+            return;
+        }
+    }
+    
+    // 逐消息日志只抽样记录类型和大小（不记录内容，auth帧含token）
+    Logger::debug_sampled("Received WebSocket message", {
+        {"type", inbound_type_name(msg.type)},
+        {"bytes", data.size()},
+        {"binary", is_binary}
+    });
+    
+    // 处理函数中的异常（如序列化失败）不能传播到Crow的I/O线程
+    try {
+        dispatch_message(conn, msg);
     } catch (const std::exception& e) {
-        std::cerr << "Error parsing WebSocket message: " << e.what() << std::endl;
+        Logger::error("Error handling WebSocket message", {
+            {"type", inbound_type_name(msg.type)},
+            {"error", e.what()}
+        });
     }
+    
+    handle_latency(msg.type).observe(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - received_at).count()));
+}
+
+void WebSocketHandler::dispatch_message(crow::websocket::connection& conn, const InboundMessage& msg) {
+    switch (msg.type) {
+        case InboundType::AUTH:
+            authenticate_connection(conn, std::string(msg.token), msg.last_message_id,
+                                    msg.binary_protocol, msg.deflate);
+            break;
+        case InboundType::CHAT:
+            handle_chat_message(conn, std::string(msg.content),
+                                msg.room.empty() ? Message::DEFAULT_ROOM : std::string(msg.room));
+            break;
+        case InboundType::JOIN_ROOM:
+            handle_join_room(conn, std::string(msg.room), msg.last_message_id);
+            break;
+        case InboundType::LEAVE_ROOM:
+            handle_leave_room(conn, std::string(msg.room));
+            break;
+        case InboundType::PRIVATE:
+            handle_private_message(conn, msg.receiver_id, std::string(msg.content));
+            break;
+        case InboundType::STATUS:
+            handle_status_change(conn, std::string(msg.status));
+            break;
+        case InboundType::RECALL:
+            handle_recall_message(conn, msg.message_id);
+            break;
+        case InboundType::UNKNOWN:
+            break;
+    }
+}
+
+bool WebSocketHandler::admit_message(crow::websocket::connection& conn) {
+    int user_id = 0;
+    uint64_t ip_key = 0;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto it = clients.find(&conn);
+        if (it == clients.end()) {
+            // 未注册的连接由各处理函数忽略
+            return true;
+        }
+        user_id = it->second->user_id;
+        ip_key = it->second->ip_key;
+    }
+    
+    // 已认证连接只按用户限流：同一NAT出口后的用户不共享配额
+    if (user_id != 0) {
+        return user_limiter.try_acquire(static_cast<uint64_t>(user_id));
+    }
+    return ip_limiter.try_acquire(ip_key);
+}
+
+uint64_t WebSocketHandler::get_rate_limited_count() const {
+    return user_limiter.get_rejected_count() + ip_limiter.get_rejected_count();
 }
 
-bool WebSocketHandler::authenticate_connection(crow::websocket::connection& conn, const std::string& token) {
+bool WebSocketHandler::authenticate_connection(crow::websocket::connection& conn, const std::string& token,
+                                               int last_message_id, bool binary_protocol, bool deflate) {
     auto validation_result = auth_service->validate_token(token);
     
     if (!validation_result.valid) {
         // 认证失败，关闭连接
-        json error_msg = {
+        static const SharedFrame auth_failed_frame = OutboundFrame::from_json({
             {"type", "error"},
             {"message", "Authentication failed"}
-        };
-        send_to_connection(&conn, error_msg.dump());
+        });
+        send_to_connection(&conn, auth_failed_frame);
         conn.close("Authentication failed");
         return false;
     }
     
     // 认证成功
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    if (clients.find(&conn) != clients.end()) {
-        clients[&conn]->user_id = validation_result.user_id;
-        clients[&conn]->username = validation_result.username;
-        user_connections[validation_result.user_id] = &conn;
+    int previous_user_id = 0;
+    std::string previous_username;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto it = clients.find(&conn);
+        if (it == clients.end()) {
+            return false;
+        }
         
-        // 添加到在线用户列表
-        chat_service->add_online_user(validation_result.user_id);
+        previous_user_id = it->second->user_id;
+        previous_username = it->second->username;
+        if (previous_user_id != 0 && previous_user_id != validation_result.user_id) {
+            // 同一连接切换身份：释放旧身份的连接映射（仅当映射仍指向该连接）
+            auto user_it = user_connections.find(previous_user_id);
+            if (user_it != user_connections.end() && user_it->second == &conn) {
+                user_connections.erase(user_it);
+            }
+        }
         
-        // 发送认证成功消息
-        json success_msg = {
-            {"type", "auth_success"},
-            {"message", "Authentication successful"}
-        };
-        send_to_connection(&conn, success_msg.dump());
+        it->second->user_id = validation_result.user_id;
+        it->second->username = validation_result.username;
+        user_connections[validation_result.user_id] = &conn;
+    }
+    
+    // 同一连接以同一用户重复认证时身份不变：保留房间订阅，也不重复计入在线连接数
+    bool reauthenticated = previous_user_id == validation_result.user_id;
+    if (previous_user_id != 0 && !reauthenticated) {
+        // 先按断开处理旧身份，否则其在线连接数永远不会归零
+        release_user(previous_user_id, previous_username);
+    }
+    
+    if (!reauthenticated) {
+        // 加入广播分片（重新注册会清空旧身份的房间订阅），并默认订阅默认房间
+        broadcast_engine.add_connection(&conn, validation_result.user_id);
+        broadcast_engine.join_room(&conn, Message::DEFAULT_ROOM);
+    }
+    
+    // 协商推送协议，此后发给该连接的帧按协商结果编码和压缩
+    if (binary_protocol || deflate || reauthenticated) {
+        broadcast_engine.set_protocol(&conn, binary_protocol, deflate);
+    }
+    
+    // 添加到在线用户列表
+    bool joined = !reauthenticated &&
+                  chat_service->add_online_user(validation_result.user_id, validation_result.username);
+    
+    // 发送认证成功消息
+    send_to_connection(&conn, OutboundFrame::from_json({
+        {"type", "auth_success"},
+        {"message", "Authentication successful"},
+        {"protocol", binary_protocol ? "binary" : "json"},
+        {"compression", deflate ? "deflate" : "none"}
+    }));
+    
+    // 补发断线期间默认房间错过的消息（单帧批量发送）
+    if (last_message_id > 0) {
+        send_history_delta(conn, validation_result.user_id, Message::DEFAULT_ROOM, last_message_id);
+    }
+    
+    // 完整在线列表只发给新连接
+    auto online_users = chat_service->get_online_users_list();
+    json user_list_msg = {
+        {"type", "user_list"},
+        {"users", json::array()}
+    };
+    
+    for (const auto& user : online_users) {
+        user_list_msg["users"].push_back(presence_user_json(user.id, user.username, user.status));
+    }
+    
+    send_to_connection(&conn, OutboundFrame::from_json(user_list_msg, "user_list"));
+    
+    if (joined) {
+        // 其他客户端只接收增量
+        broadcast_presence(validation_result.user_id, {
+            {"type", "presence"},
+            {"event", "join"},
+            {"user", presence_user_json(validation_result.user_id, validation_result.username, UserStatus::ONLINE)}
+        });
         
         // 广播用户加入消息
         chat_service->send_user_join_notification(validation_result.username);
-        
-        // 发送在线用户列表
-        auto online_users = chat_service->get_online_users_list();
-        json user_list_msg = {
-            {"type", "user_list"},
-            {"users", json::array()}
-        };
-        
-        for (const auto& user : online_users) {
-            user_list_msg["users"].push_back({
-                {"id", user.id},
-                {"username", user.username},
-                {"status", User::status_to_string(user.status)}
-            });
-        }
-        
-        broadcast_message(user_list_msg.dump());
-        
-        return true;
     }
     
-    return false;
+    return true;
 }
 
-void WebSocketHandler::handle_chat_message(crow::websocket::connection& conn, const std::string& content) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    auto it = clients.find(&conn);
+void WebSocketHandler::broadcast_presence(int user_id, const json& delta) {
+    // 同一用户的在线状态增量共用合并键，慢消费者只会收到最新的一条
+    broadcast_message(OutboundFrame::from_json(delta, "presence:" + std::to_string(user_id)), user_id);
+}
+
+void WebSocketHandler::send_history_delta(crow::websocket::connection& conn, int user_id, 
+                                          const std::string& room, int last_message_id) {
+    // 连接已订阅房间，补发期间到达的新消息可能与实时推送重复，客户端按ID去重
+    auto page = chat_service->get_missed_messages(user_id, room, last_message_id);
     
-    if (it == clients.end() || it->second->user_id == 0) {
+    json delta_msg = {
+        {"type", "history_delta"},
+        {"room", room},
+        {"messages", json::array()},
+        {"has_more", page.has_more},
+        {"last_id", page.last_id}
+    };
+    
+    for (const auto& message : page.messages) {
+        delta_msg["messages"].push_back(message_to_json(message));
+    }
+    
+    send_to_connection(&conn, OutboundFrame::from_json(delta_msg));
+}
+
+void WebSocketHandler::handle_chat_message(crow::websocket::connection& conn, const std::string& content,
+                                           const std::string& room) {
+    ClientConnection client;
+    if (!get_authenticated_client(conn, client)) {
         // 未认证用户
         return;
     }
     
-    auto client = it->second.get();
-    auto result = chat_service->send_message(client->user_id, content);
-    
-    if (result.success && result.processed_message) {
-        // 广播消息给所有连接的客户端
-        json broadcast_msg = {
-            {"type", "message"},
-            {"message", {
-                {"id", result.processed_message->id},
-                {"sender_id", result.processed_message->sender_id},
-                {"sender_username", client->username},
-                {"content", result.processed_message->content},
-                {"timestamp", result.processed_message->timestamp},
-                {"type", Message::type_to_string(result.processed_message->type)}
-            }}
-        };
-        
-        broadcast_message(broadcast_msg.dump(), client->user_id);
+    // 只能向已加入的房间发言
+    if (!broadcast_engine.in_room(&conn, room)) {
+        send_room_error(conn, room, "Not a member of this room");
+        return;
+    }
+    
+    // 屏蔽了发送者的用户在扇出时跳过
+    auto blockers = chat_service->get_blockers(client.user_id);
+    
+    // 在房间锁内发布，同一房间的广播顺序与消息ID顺序一致，客户端按最后收到的ID续传不会漏消息
+    chat_service->send_message(client.user_id, content, MessageType::PUBLIC, -1, client.username, room,
+        [&](const Message& message) {
+            // 只广播给房间内的订阅者
+            json broadcast_msg = {
+                {"type", "message"},
+                {"message", message_to_json(message)}
+            };
+            broadcast_message(OutboundFrame::from_json(broadcast_msg), client.user_id, room, blockers);
+        });
+}
+
+void WebSocketHandler::handle_join_room(crow::websocket::connection& conn, const std::string& room, 
+                                        int last_message_id) {
+    ClientConnection client;
+    if (!get_authenticated_client(conn, client)) return;
+    
+    switch (broadcast_engine.join_room(&conn, room)) {
+        case BroadcastEngine::JoinResult::JOINED:
+            break;
+        case BroadcastEngine::JoinResult::INVALID_ROOM:
+            send_room_error(conn, room, "Invalid room name");
+            return;
+        case BroadcastEngine::JoinResult::TOO_MANY_ROOMS:
+            send_room_error(conn, room, "Too many rooms joined");
+            return;
+        case BroadcastEngine::JoinResult::NOT_REGISTERED:
+            return;
+    }
+    
+    send_to_connection(&conn, OutboundFrame::from_json({
+        {"type", "room_joined"},
+        {"room", room}
+    }));
+    
+    if (last_message_id > 0) {
+        send_history_delta(conn, client.user_id, room, last_message_id);
+    }
+}
+
+void WebSocketHandler::handle_leave_room(crow::websocket::connection& conn, const std::string& room) {
+    ClientConnection client;
+    if (!get_authenticated_client(conn, client)) return;
+    
+    if (broadcast_engine.leave_room(&conn, room)) {
+        send_to_connection(&conn, OutboundFrame::from_json({
+            {"type", "room_left"},
+            {"room", room}
+        }));
     }
 }
 
-void WebSocketHandler::handle_private_message(crow::websocket::connection& conn, const std::string& message) {
+void WebSocketHandler::send_room_error(crow::websocket::connection& conn, const std::string& room, 
+                                       const std::string& message) {
+    send_to_connection(&conn, OutboundFrame::from_json({
+        {"type", "error"},
+        {"room", room},
+        {"message", message}
+    }));
+}
+
+void WebSocketHandler::handle_private_message(crow::websocket::connection& conn, int receiver_id, 
+                                              const std::string& content) {
     try {
-        json msg = json::parse(message);
-        
-        std::lock_guard<std::mutex> lock(clients_mutex);
-        auto it = clients.find(&conn);
-        
-        if (it == clients.end() || it->second->user_id == 0) return;
+        ClientConnection client;
+        if (!get_authenticated_client(conn, client)) return;
         
-        auto client = it->second.get();
-        int receiver_id = msg["receiver_id"];
-        std::string content = msg["content"];
-        
-        auto result = chat_service->send_message(client->user_id, content, MessageType::PRIVATE, receiver_id);
+        auto result = chat_service->send_message(client.user_id, content, MessageType::PRIVATE, receiver_id, client.username);
         
         if (result.success && result.processed_message) {
             json private_msg = {
@@ -168,86 +421,89 @@ void WebSocketHandler::handle_private_message(crow::websocket::connection& conn,
                     {"id", result.processed_message->id},
                     {"sender_id", result.processed_message->sender_id},
                     {"receiver_id", result.processed_message->receiver_id},
-                    {"sender_username", client->username},
+                    {"sender_username", client.username},
                     {"content", result.processed_message->content},
                     {"timestamp", result.processed_message->timestamp}
                 }}
             };
             
-            // 发送给接收者
-            send_to_user(receiver_id, private_msg.dump());
+            // 只序列化一次，接收者和发送者共享同一帧
+            auto frame = OutboundFrame::from_json(private_msg);
+            
+            // 发送给接收者（接收者屏蔽了发送者时不推送）
+            if (!chat_service->should_filter_message(receiver_id, *result.processed_message)) {
+                send_to_user(receiver_id, frame);
+            }
             // 也发送给发送者（确认消息）
-            send_to_connection(&conn, private_msg.dump());
+            send_to_connection(&conn, frame);
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error handling private message: " << e.what() << std::endl;
+        Logger::error("Error handling private message", {{"error", e.what()}});
     }
 }
 
 void WebSocketHandler::handle_status_change(crow::websocket::connection& conn, const std::string& status) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    auto it = clients.find(&conn);
-    
-    if (it == clients.end() || it->second->user_id == 0) return;
+    ClientConnection client;
+    if (!get_authenticated_client(conn, client)) return;
     
-    auto client = it->second.get();
     UserStatus user_status = User::string_to_status(status);
     
-    if (auth_service->update_user_status(client->user_id, user_status)) {
-        // 广播状态更新
-        json status_msg = {
+    if (chat_service->update_user_status(client.user_id, user_status)) {
+        // 广播状态增量（携带完整用户信息，客户端可直接覆盖）
+        broadcast_presence(client.user_id, {
             {"type", "status_update"},
-            {"user_id", client->user_id},
-            {"username", client->username},
-            {"status", status}
-        };
-        
-        broadcast_message(status_msg.dump());
+            {"user_id", client.user_id},
+            {"username", client.username},
+            {"status", User::status_to_string(user_status)}
+        });
     }
 }
 
 void WebSocketHandler::handle_recall_message(crow::websocket::connection& conn, int message_id) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    auto it = clients.find(&conn);
-    
-    if (it == clients.end() || it->second->user_id == 0) return;
-    
-    auto client = it->second.get();
+    ClientConnection client;
+    if (!get_authenticated_client(conn, client)) return;
     
-    if (chat_service->recall_message(message_id, client->user_id)) {
-        // 广播消息撤回
+    std::string room;
+    if (chat_service->recall_message(message_id, client.user_id, &room)) {
+        // 在消息所在的房间广播撤回
         json recall_msg = {
             {"type", "message_recalled"},
-            {"message_id", message_id}
+            {"message_id", message_id},
+            {"room", room}
         };
         
-        broadcast_message(recall_msg.dump());
+        broadcast_message(OutboundFrame::from_json(recall_msg), -1, room,
+                          chat_service->get_blockers(client.user_id));
     }
 }
 
-void WebSocketHandler::broadcast_message(const std::string& message, int exclude_user_id) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    
-    for (const auto& pair : clients) {
-        auto client = pair.second.get();
-        if (client->user_id != 0 && client->user_id != exclude_user_id) {
-            client->conn->send_text(message);
-        }
-    }
+void WebSocketHandler::broadcast_message(const SharedFrame& frame, int exclude_user_id, const std::string& room,
+                                         BroadcastEngine::UserList skip_users) {
+    // 只发布一次，由各分片线程异步推送
+    broadcast_engine.publish(frame, exclude_user_id, room, std::move(skip_users));
 }
 
-void WebSocketHandler::send_to_user(int user_id, const std::string& message) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    
-    auto it = user_connections.find(user_id);
-    if (it != user_connections.end()) {
-        it->second->send_text(message);
+void WebSocketHandler::send_to_user(int user_id, const SharedFrame& frame) {
+    crow::websocket::connection* conn = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto it = user_connections.find(user_id);
+        if (it == user_connections.end()) {
+            return;
+        }
+        conn = it->second;
     }
+    
+    // 连接可能已被关闭，只经由广播引擎发送（引擎内部会确认连接仍然存在）
+    broadcast_engine.send_to(conn, frame);
 }
 
-void WebSocketHandler::send_to_connection(crow::websocket::connection* conn, const std::string& message) {
-    if (conn) {
-        conn->send_text(message);
+void WebSocketHandler::send_to_connection(crow::websocket::connection* conn, const SharedFrame& frame) {
+    if (!conn || !frame) return;
+    
+    // 已认证连接走有界出站队列；未认证连接（如认证失败通知）直接发送
+    if (!broadcast_engine.send_to(conn, frame)) {
+        conn->send_text(frame->text());
     }
 }
 
@@ -273,24 +529,59 @@ std::vector<std::string> WebSocketHandler::get_connected_users() {
     return usernames;
 }
 
-void WebSocketHandler::cleanup_connection(crow::websocket::connection& conn) {
+bool WebSocketHandler::get_authenticated_client(crow::websocket::connection& conn, ClientConnection& client) {
     std::lock_guard<std::mutex> lock(clients_mutex);
-    
     auto it = clients.find(&conn);
-    if (it != clients.end()) {
-        auto client = it->second.get();
+    
+    if (it == clients.end() || it->second->user_id == 0) {
+        return false;
+    }
+    
+    client = *it->second;
+    return true;
+}
+
+void WebSocketHandler::cleanup_connection(crow::websocket::connection& conn) {
+    // 先从广播分片移除，之后分片线程不会再访问该连接
+    broadcast_engine.remove_connection(&conn);
+    
+    int user_id = 0;
+    std::string username;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
         
-        if (client->user_id != 0) {
-            // 从在线用户列表移除
-            chat_service->remove_online_user(client->user_id);
-            
-            // 广播用户离开消息
-            chat_service->send_user_leave_notification(client->username);
-            
-            // 从用户连接映射中移除
-            user_connections.erase(client->user_id);
+        auto it = clients.find(&conn);
+        if (it == clients.end()) {
+            return;
+        }
+        
+        user_id = it->second->user_id;
+        username = it->second->username;
+        
+        // 从用户连接映射中移除（仅当映射仍指向该连接）
+        auto user_it = user_connections.find(user_id);
+        if (user_id != 0 && user_it != user_connections.end() && user_it->second == &conn) {
+            user_connections.erase(user_it);
         }
         
         clients.erase(it);
     }
+    
+    if (user_id != 0) {
+        release_user(user_id, username);
+    }
+}
+
+void WebSocketHandler::release_user(int user_id, const std::string& username) {
+    // 同一用户的最后一个连接断开时才算离线
+    if (chat_service->remove_online_user(user_id)) {
+        broadcast_presence(user_id, {
+            {"type", "presence"},
+            {"event", "leave"},
+            {"user_id", user_id}
+        });
+        
+        // 广播用户离开消息
+        chat_service->send_user_leave_notification(username);
+    }
 }
@@ -3,12 +3,18 @@
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <nlohmann/json.hpp>
 
 #include "database/database_manager.h"
 #include "services/auth_service.h"
 #include "services/chat_service.h"
 #include "handlers/websocket_handler.h"
+#include "utils/logger.h"
+#include "utils/metrics.h"
+#include "utils/rate_limiter.h"
 
 class ChatRoomServer {
 private:
@@ -18,18 +24,34 @@ private:
     std::shared_ptr<ChatService> chat_service;
     std::shared_ptr<WebSocketHandler> websocket_handler;
     
+    // 登录/注册限流（密码哈希开销大，也是撞库入口）：
+    // 按用户名+IP限制单个账号的尝试次数；按IP的上限只防单一来源喷洒大量用户名，
+    // 默认值按校园/企业NAT后上千用户同时重连估算，不会拒绝正常的重连风暴
+    RateLimiter auth_limiter;
+    RateLimiter auth_ip_limiter;
+    
+    // /metrics访问令牌（CHATROOM_METRICS_TOKEN）；未设置时只允许本机抓取
+    std::string metrics_token;
+    
     // 线程池相关（体现进程间通信概念）
     std::vector<std::thread> worker_threads;
     bool running;
     
 public:
-    ChatRoomServer() : running(false) {}
+    ChatRoomServer()
+        : auth_limiter(RateLimiter::Limits::from_env("CHATROOM_RATE_LIMIT_AUTH", {10, 0.5})),
+          auth_ip_limiter(RateLimiter::Limits::from_env("CHATROOM_RATE_LIMIT_AUTH_IP", {2000, 50.0})),
+          running(false) {
+        if (const char* token = std::getenv("CHATROOM_METRICS_TOKEN")) {
+            metrics_token = token;
+        }
+    }
     
     bool initialize() {
         // 初始化数据库
         db = std::make_shared<DatabaseManager>("chatroom.db");
         if (!db->initialize()) {
-            std::cerr << "Failed to initialize database" << std::endl;
+            Logger::error("Failed to initialize database");
             return false;
         }
         
@@ -40,6 +62,7 @@ public:
         
         setup_routes();
         setup_cors();
+        register_metrics();
         
         return true;
     }
@@ -52,15 +75,15 @@ public:
                 "<h1>Chat Room Server</h1><p>WebSocket endpoint: /ws</p>");
         });
         
-        // 用户认证API
+        // 用户认证API（异步处理：响应在密码哈希完成后由哈希线程结束，请求线程不等待）
         CROW_ROUTE(app, "/api/auth/register").methods("POST"_method)
-        ([this](const crow::request& req) {
-            return handle_register(req);
+        ([this](const crow::request& req, crow::response& res) {
+            handle_register(req, res);
         });
         
         CROW_ROUTE(app, "/api/auth/login").methods("POST"_method)
-        ([this](const crow::request& req) {
-            return handle_login(req);
+        ([this](const crow::request& req, crow::response& res) {
+            handle_login(req, res);
         });
         
         CROW_ROUTE(app, "/api/auth/logout").methods("POST"_method)
@@ -84,6 +107,15 @@ public:
             return handle_block_user(req);
         });
         
+        // 监控指标（Prometheus文本格式），指标暴露内部负载，不对公网开放
+        CROW_ROUTE(app, "/metrics").methods("GET"_method)
+        ([this](const crow::request& req) {
+            if (!admit_metrics_request(req)) {
+                return crow::response(403);
+            }
+            return crow::response(200, "text/plain; version=0.0.4", Metrics::instance().render());
+        });
+        
         // WebSocket路由
         CROW_ROUTE(app, "/ws")
         .websocket(&app)
@@ -106,6 +138,42 @@ public:
             .origin("http://localhost:5173"); // Vue开发服务器地址
     }
     
+    // 抓取时读取的组件状态
+    void register_metrics() {
+        Metrics& metrics = Metrics::instance();
+        const BroadcastEngine& engine = websocket_handler->get_broadcast_engine();
+        
+        metrics.callback("chatroom_ws_connections", "Open WebSocket connections",
+                         [&engine]() { return static_cast<double>(engine.get_connection_count()); });
+        metrics.callback("chatroom_online_users", "Users with at least one authenticated connection",
+                         [this]() { return static_cast<double>(chat_service->get_online_count()); });
+        metrics.callback("chatroom_rooms", "Rooms with at least one subscribed connection",
+                         [&engine]() { return static_cast<double>(engine.get_room_count()); });
+        metrics.callback("chatroom_outbound_queue_frames", "Frames waiting in per-connection outbound queues",
+                         [&engine]() { return static_cast<double>(engine.get_queue_stats().frames); });
+        metrics.callback("chatroom_outbound_queue_bytes", "Bytes waiting in per-connection outbound queues",
+                         [&engine]() { return static_cast<double>(engine.get_queue_stats().bytes); });
+        metrics.callback("chatroom_message_write_queue_depth", "Messages waiting for the database writer",
+                         [this]() { return static_cast<double>(chat_service->get_write_queue_depth()); });
+        metrics.callback("chatroom_broadcast_dropped_total", "Broadcasts skipped by lagging shards",
+                         [&engine]() { return static_cast<double>(engine.get_dropped_count()); }, true);
+        metrics.callback("chatroom_slow_consumer_drops_total", "Frames dropped from slow consumers' queues",
+                         [&engine]() { return static_cast<double>(engine.get_slow_consumer_drops()); }, true);
+        metrics.callback("chatroom_slow_consumer_disconnects_total", "Connections closed as slow consumers",
+                         [&engine]() { return static_cast<double>(engine.get_slow_consumer_disconnects()); }, true);
+        metrics.callback("chatroom_rate_limited_total", "Requests rejected by rate limiting",
+                         [this]() { return static_cast<double>(websocket_handler->get_rate_limited_count()); },
+                         true, "path=\"websocket\"");
+        metrics.callback("chatroom_rate_limited_total", "",
+                         [this]() { return static_cast<double>(auth_limiter.get_rejected_count()); },
+                         true, "path=\"auth\"");
+        metrics.callback("chatroom_rate_limited_total", "",
+                         [this]() { return static_cast<double>(auth_ip_limiter.get_rejected_count()); },
+                         true, "path=\"auth_ip\"");
+        metrics.callback("chatroom_log_dropped_total", "Log records dropped because a thread's buffer was full",
+                         []() { return static_cast<double>(Logger::get_dropped_count()); }, true);
+    }
+    
     void start_background_tasks() {
         running = true;
         
@@ -114,8 +182,8 @@ public:
             while (running) {
                 std::this_thread::sleep_for(std::chrono::hours(1));
                 if (running) {
-                    db->cleanup_old_messages();
-                    std::cout << "Cleaned up old messages" << std::endl;
+                    chat_service->cleanup_old_messages();
+                    Logger::info("Cleaned up old messages");
                 }
             }
         });
@@ -126,7 +194,9 @@ public:
                 std::this_thread::sleep_for(std::chrono::minutes(5));
                 if (running) {
                     // 检查离线用户状态
-                    std::cout << "Checking user status..." << std::endl;
+                    // 清理过期会话
+                    size_t evicted = auth_service->evict_expired_sessions();
+                    Logger::info("Evicted expired revocations", {{"count", evicted}});
                 }
             }
         });
@@ -135,9 +205,11 @@ public:
     void run(int port = 8080) {
         start_background_tasks();
         
-        std::cout << "Starting Chat Room Server on port " << port << std::endl;
-        std::cout << "WebSocket endpoint: ws://localhost:" << port << "/ws" << std::endl;
+        Logger::info("Starting Chat Room Server", {{"port", port}});
+        Logger::info("WebSocket endpoint ready", {{"url", "ws://localhost:" + std::to_string(port) + "/ws"}});
         
+        // 客户端声明支持时压缩HTTP响应（主要是历史记录）
+        app.use_compression(crow::compression::algorithm::GZIP);
         app.port(port).multithreaded().run();
     }
     
@@ -151,66 +223,91 @@ public:
     }
     
     // API处理函数
-    crow::response handle_register(const crow::request& req) {
+    void handle_register(const crow::request& req, crow::response& res) {
+        std::string username, password, email;
         try {
             nlohmann::json request_data = nlohmann::json::parse(req.body);
             
-            std::string username = request_data["username"];
-            std::string password = request_data["password"];
-            std::string email = request_data["email"];
-            
-            auto result = auth_service->register_user(username, password, email);
-            
-            nlohmann::json response = {
-                {"success", result.success},
-                {"message", result.message}
-            };
-            
-            if (result.success && result.user) {
-                response["user"] = {
-                    {"id", result.user->id},
-                    {"username", result.user->username},
-                    {"email", result.user->email},
-                    {"status", User::status_to_string(result.user->status)}
-                };
-            }
-            
-            return crow::response(result.success ? 200 : 400, "application/json", response.dump());
+            username = request_data["username"];
+            password = request_data["password"];
+            email = request_data["email"];
         } catch (const std::exception& e) {
             nlohmann::json error = {{"success", false}, {"message", "Invalid request format"}};
-            return crow::response(400, "application/json", error.dump());
+            end_response(res, 400, error.dump());
+            return;
+        }
+        
+        if (!admit_auth_request(req, username)) {
+            end_response(res, 429, rate_limited_body());
+            return;
         }
+        
+        // Crow在res.end()之前保持连接和res有效
+        auth_service->register_user(username, password, email, [&res](AuthService::RegisterResult result) {
+            try {
+                nlohmann::json response = {
+                    {"success", result.success},
+                    {"message", result.message}
+                };
+                
+                if (result.success && result.user) {
+                    response["user"] = {
+                        {"id", result.user->id},
+                        {"username", result.user->username},
+                        {"email", result.user->email},
+                        {"status", User::status_to_string(result.user->status)}
+                    };
+                }
+                
+                end_response(res, result.success ? 200 : 400, response.dump());
+            } catch (const std::exception& e) {
+                Logger::error("Error completing register response", {{"error", e.what()}});
+                end_response(res, 500, internal_error_body());
+            }
+        });
     }
     
-    crow::response handle_login(const crow::request& req) {
+    void handle_login(const crow::request& req, crow::response& res) {
+        std::string username, password;
         try {
             nlohmann::json request_data = nlohmann::json::parse(req.body);
             
-            std::string username = request_data["username"];
-            std::string password = request_data["password"];
-            
-            auto result = auth_service->login_user(username, password);
-            
-            nlohmann::json response = {
-                {"success", result.success},
-                {"message", result.message}
-            };
-            
-            if (result.success && result.user) {
-                response["user"] = {
-                    {"id", result.user->id},
-                    {"username", result.user->username},
-                    {"email", result.user->email},
-                    {"status", User::status_to_string(result.user->status)}
-                };
-                response["token"] = result.token;
-            }
-            
-            return crow::response(result.success ? 200 : 401, "application/json", response.dump());
+            username = request_data["username"];
+            password = request_data["password"];
         } catch (const std::exception& e) {
             nlohmann::json error = {{"success", false}, {"message", "Invalid request format"}};
-            return crow::response(400, "application/json", error.dump());
+            end_response(res, 400, error.dump());
+            return;
+        }
+        
+        if (!admit_auth_request(req, username)) {
+            end_response(res, 429, rate_limited_body());
+            return;
         }
+        
+        auth_service->login_user(username, password, [&res](AuthService::LoginResult result) {
+            try {
+                nlohmann::json response = {
+                    {"success", result.success},
+                    {"message", result.message}
+                };
+                
+                if (result.success && result.user) {
+                    response["user"] = {
+                        {"id", result.user->id},
+                        {"username", result.user->username},
+                        {"email", result.user->email},
+                        {"status", User::status_to_string(result.user->status)}
+                    };
+                    response["token"] = result.token;
+                }
+                
+                end_response(res, result.success ? 200 : 401, response.dump());
+            } catch (const std::exception& e) {
+                Logger::error("Error completing login response", {{"error", e.what()}});
+                end_response(res, 500, internal_error_body());
+            }
+        });
     }
     
     crow::response handle_logout(const crow::request& req) {
@@ -258,13 +355,36 @@ public:
                 return crow::response(401, "application/json", error.dump());
             }
             
-            auto messages = chat_service->get_chat_history(validation.user_id);
+            // 键集分页参数：room为房间名，before_id/after_id为消息ID游标，limit为每页条数
+            const char* room_param = req.url_params.get("room");
+            std::string room = room_param && *room_param ? room_param : Message::DEFAULT_ROOM;
+            if (!Message::is_valid_room_name(room)) {
+                nlohmann::json error = {{"success", false}, {"message", "Invalid room name"}};
+                return crow::response(400, "application/json", error.dump());
+            }
+            
+            int before_id = 0;
+            int after_id = 0;
+            int limit = 100;
+            if (!parse_int_param(req, "before_id", before_id) ||
+                !parse_int_param(req, "after_id", after_id) ||
+                !parse_int_param(req, "limit", limit) ||
+                before_id < 0 || after_id < 0 || limit <= 0) {
+                nlohmann::json error = {{"success", false}, {"message", "Invalid pagination parameters"}};
+                return crow::response(400, "application/json", error.dump());
+            }
+            
+            auto page = chat_service->get_chat_history_page(validation.user_id, room, after_id, before_id, limit);
             nlohmann::json response = {
                 {"success", true},
-                {"messages", nlohmann::json::array()}
+                {"room", room},
+                {"messages", nlohmann::json::array()},
+                {"has_more", page.has_more},
+                {"first_id", page.first_id},
+                {"last_id", page.last_id}
             };
             
-            for (const auto& msg : messages) {
+            for (const auto& msg : page.messages) {
                 response["messages"].push_back({
                     {"id", msg.id},
                     {"sender_id", msg.sender_id},
@@ -351,20 +471,84 @@ public:
             return crow::response(500, "application/json", error.dump());
         }
     }
+    
+    // 读取可选的整数查询参数；参数不存在时保留默认值，格式错误时返回false
+    static bool parse_int_param(const crow::request& req, const char* name, int& value) {
+        const char* raw = req.url_params.get(name);
+        if (!raw || *raw == '\0') {
+            return true;
+        }
+        
+        char* end = nullptr;
+        errno = 0;
+        long parsed = std::strtol(raw, &end, 10);
+        if (errno != 0 || *end != '\0' || parsed < INT_MIN || parsed > INT_MAX) {
+            return false;
+        }
+        
+        value = static_cast<int>(parsed);
+        return true;
+    }
+    
+    // 在密码哈希之前消耗令牌：先按用户名+IP，再按IP（被用户名桶拒绝的请求不占用IP配额）
+    bool admit_auth_request(const crow::request& req, const std::string& username) {
+        uint64_t ip_key = std::hash<std::string>()(req.remote_ip_address);
+        uint64_t user_key = std::hash<std::string>()(username + '\n' + req.remote_ip_address);
+        return auth_limiter.try_acquire(user_key) && auth_ip_limiter.try_acquire(ip_key);
+    }
+    
+    // 设置了CHATROOM_METRICS_TOKEN时要求"Authorization: Bearer <token>"，否则只接受回环地址的请求
+    bool admit_metrics_request(const crow::request& req) const {
+        if (metrics_token.empty()) {
+            const std::string& ip = req.remote_ip_address;
+            return ip == "127.0.0.1" || ip == "::1" || ip == "::ffff:127.0.0.1";
+        }
+        
+        const std::string& header = req.get_header_value("Authorization");
+        const std::string prefix = "Bearer ";
+        if (header.size() != prefix.size() + metrics_token.size() || header.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        // 定长比较，不因提前返回泄露令牌前缀
+        unsigned char diff = 0;
+        for (size_t i = 0; i < metrics_token.size(); ++i) {
+            diff |= static_cast<unsigned char>(header[prefix.size() + i] ^ metrics_token[i]);
+        }
+        return diff == 0;
+    }
+    
+    static const std::string& rate_limited_body() {
+        static const std::string body =
+            nlohmann::json{{"success", false}, {"message", "Too many requests"}}.dump();
+        return body;
+    }
+    
+    static const std::string& internal_error_body() {
+        static const std::string body =
+            nlohmann::json{{"success", false}, {"message", "Internal server error"}}.dump();
+        return body;
+    }
+    
+    // 结束异步处理的JSON响应（可在任意线程调用，每个响应只能调用一次）
+    static void end_response(crow::response& res, int code, const std::string& body) {
+        res.code = code;
+        res.set_header("Content-Type", "application/json");
+        res.end(body);
+    }
 };
 
 int main() {
     ChatRoomServer server;
     
     if (!server.initialize()) {
-        std::cerr << "Failed to initialize server" << std::endl;
+        Logger::error("Failed to initialize server");
         return 1;
     }
     
     try {
         server.run(8080);
     } catch (const std::exception& e) {
-        std::cerr << "Server error: " << e.what() << std::endl;
+        Logger::error("Server error", {{"error", e.what()}});
         server.stop();
         return 1;
     }
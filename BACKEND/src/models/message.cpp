@@ -12,7 +12,8 @@ std::string Message::to_json() const {
     json << "\"type\":\"" << type_to_string(type) << "\",";
     json << "\"timestamp\":" << timestamp << ",";
     json << "\"is_deleted\":" << (is_deleted ? "true" : "false") << ",";
-    json << "\"sender_username\":\"" << sender_username << "\"";
+    json << "\"sender_username\":\"" << sender_username << "\",";
+    json << "\"room_id\":\"" << room_id << "\"";
     json << "}";
     return json.str();
 }
@@ -26,6 +27,18 @@ bool Message::can_be_recalled() const {
     return (now - timestamp) <= 120; // 2分钟内可以撤回
 }
 
+bool Message::is_valid_room_name(const std::string& room_id) {
+    if (room_id.empty() || room_id.size() > 32) {
+        return false;
+    }
+    for (char c : room_id) {
+        bool allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                       (c >= '0' && c <= '9') || c == '_' || c == '-';
+        if (!allowed) return false;
+    }
+    return true;
+}
+
 std::string Message::type_to_string(MessageType type) {
     switch (type) {
         case MessageType::PUBLIC: return "PUBLIC";
@@ -1,8 +1,64 @@
 #include "../include/models/user.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
 #include <sstream>
 #include <iomanip>
 #include <functional>
 #include <random>
+#include <vector>
+#include <cstdint>
+
+namespace {
+
+// scrypt参数：N=2^14, r=8, p=1，每次计算约占用16MB内存
+const uint64_t SCRYPT_N = 16384;
+const uint64_t SCRYPT_R = 8;
+const uint64_t SCRYPT_P = 1;
+const uint64_t SCRYPT_MAX_MEM = 64 * 1024 * 1024;
+const size_t SALT_LENGTH = 16;
+const size_t KEY_LENGTH = 32;
+const char SCRYPT_PREFIX[] = "scrypt$";
+
+std::string to_hex(const unsigned char* data, size_t length) {
+    std::ostringstream ss;
+    ss << std::hex << std::setfill('0');
+    for (size_t i = 0; i < length; ++i) {
+        ss << std::setw(2) << static_cast<int>(data[i]);
+    }
+    return ss.str();
+}
+
+bool from_hex(const std::string& hex, std::vector<unsigned char>& out) {
+    if (hex.size() % 2 != 0) return false;
+    out.clear();
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        try {
+            out.push_back(static_cast<unsigned char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+        } catch (...) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool scrypt_derive(const std::string& password, const unsigned char* salt, size_t salt_length,
+                   uint64_t n, uint64_t r, uint64_t p, unsigned char* key, size_t key_length) {
+    return EVP_PBE_scrypt(password.data(), password.size(), salt, salt_length,
+                          n, r, p, SCRYPT_MAX_MEM, key, key_length) == 1;
+}
+
+// 旧版哈希（std::hash + 固定盐），仅用于验证存量用户
+std::string legacy_hash_password(const std::string& password) {
+    std::hash<std::string> hasher;
+    size_t hash_value = hasher(password + "salt_key_for_security");
+    
+    std::stringstream ss;
+    ss << std::hex << hash_value;
+    return ss.str();
+}
+
+} // namespace
 
 std::string User::to_json() const {
     std::ostringstream json;
@@ -18,19 +74,63 @@ std::string User::to_json() const {
 }
 
 bool User::verify_password(const std::string& password) const {
-    return hash_password(password) == password_hash;
+    return verify_password_hash(password, password_hash);
+}
+
+bool User::verify_password_hash(const std::string& password, const std::string& password_hash) {
+    if (needs_rehash(password_hash)) {
+        std::string legacy = legacy_hash_password(password);
+        return legacy.size() == password_hash.size() &&
+               CRYPTO_memcmp(legacy.data(), password_hash.data(), legacy.size()) == 0;
+    }
+    
+    // 格式：scrypt$N$r$p$盐值$哈希（十六进制）
+    std::istringstream ss(password_hash.substr(sizeof(SCRYPT_PREFIX) - 1));
+    std::string n_str, r_str, p_str, salt_hex, key_hex;
+    if (!std::getline(ss, n_str, '$') || !std::getline(ss, r_str, '$') ||
+        !std::getline(ss, p_str, '$') || !std::getline(ss, salt_hex, '$') ||
+        !std::getline(ss, key_hex)) {
+        return false;
+    }
+    
+    std::vector<unsigned char> salt, expected;
+    if (!from_hex(salt_hex, salt) || !from_hex(key_hex, expected) || expected.empty()) {
+        return false;
+    }
+    
+    std::vector<unsigned char> key(expected.size());
+    try {
+        if (!scrypt_derive(password, salt.data(), salt.size(),
+                           std::stoull(n_str), std::stoull(r_str), std::stoull(p_str),
+                           key.data(), key.size())) {
+            return false;
+        }
+    } catch (...) {
+        return false;
+    }
+    
+    return CRYPTO_memcmp(key.data(), expected.data(), key.size()) == 0;
 }
 
 std::string User::hash_password(const std::string& password) {
-    // 使用简单的哈希函数替代SHA-256（仅用于演示）
-    std::hash<std::string> hasher;
-    size_t hash_value = hasher(password + "salt_key_for_security");
+    unsigned char salt[SALT_LENGTH];
+    unsigned char key[KEY_LENGTH];
     
-    std::stringstream ss;
-    ss << std::hex << hash_value;
+    if (RAND_bytes(salt, sizeof(salt)) != 1 ||
+        !scrypt_derive(password, salt, sizeof(salt), SCRYPT_N, SCRYPT_R, SCRYPT_P, key, sizeof(key))) {
+        return "";
+    }
+    
+    std::ostringstream ss;
+    ss << SCRYPT_PREFIX << SCRYPT_N << '$' << SCRYPT_R << '$' << SCRYPT_P << '$'
+       << to_hex(salt, sizeof(salt)) << '$' << to_hex(key, sizeof(key));
     return ss.str();
 }
 
+bool User::needs_rehash(const std::string& password_hash) {
+    return password_hash.compare(0, sizeof(SCRYPT_PREFIX) - 1, SCRYPT_PREFIX) != 0;
+}
+
 std::string User::status_to_string(UserStatus status) {
     switch (status) {
         case UserStatus::ONLINE: return "ONLINE";
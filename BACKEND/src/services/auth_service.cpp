@@ -1,170 +1,211 @@
 #include "../include/services/auth_service.h"
 #include "../include/database/database_manager.h"
+#include "../include/services/password_hasher.h"
 #include <regex>
 #include <sstream>
 #include <iomanip>
-#include <random>
+#include <algorithm>
+#include <chrono>
 #include <ctime>
 
-// 简单的token生成函数（替代JWT）
-std::string generate_simple_token(const User& user) {
-    std::stringstream ss;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 15);
-    
-    // 生成简单token: user_id:timestamp:random_string
-    ss << user.id << ":" << std::time(nullptr) << ":";
-    for (int i = 0; i < 32; ++i) {
-        ss << std::hex << dis(gen);
-    }
-    return ss.str();
+namespace {
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
 }
 
-// 简单的token解析函数
-bool parse_simple_token(const std::string& token, int& user_id, std::time_t& timestamp) {
-    size_t first_colon = token.find(':');
-    size_t second_colon = token.find(':', first_colon + 1);
-    
-    if (first_colon == std::string::npos || second_colon == std::string::npos) {
-        return false;
-    }
-    
-    try {
-        user_id = std::stoi(token.substr(0, first_colon));
-        timestamp = std::stol(token.substr(first_colon + 1, second_colon - first_colon - 1));
-        return true;
-    } catch (...) {
-        return false;
+} // namespace
+
+AuthService::AuthService(std::shared_ptr<DatabaseManager> database)
+    : db(database), hasher(std::make_shared<PasswordHasher>()) {
+    // 加载仍可能有未过期token的注销记录；新签发的时间戳必须晚于所有已加载的注销时间
+    int64_t latest = 0;
+    for (const auto& entry : db->get_revocations(now_ms() - TOKEN_TTL_SECONDS * 1000)) {
+        revocations.revoke_user(entry.first, entry.second);
+        latest = std::max(latest, entry.second);
     }
+    last_issue_stamp = latest;
 }
 
-AuthService::AuthService(std::shared_ptr<DatabaseManager> database) : db(database) {}
-
-AuthService::RegisterResult AuthService::register_user(const std::string& username, 
-                                                     const std::string& password, 
-                                                     const std::string& email) {
+void AuthService::register_user(const std::string& username, 
+                                const std::string& password, 
+                                const std::string& email,
+                                RegisterCallback done) {
     RegisterResult result;
     result.success = false;
     
     // 验证输入
     if (username.empty() || password.empty() || email.empty()) {
         result.message = "All fields are required";
-        return result;
+        done(std::move(result));
+        return;
     }
     
     if (!validate_email(email)) {
         result.message = "Invalid email format";
-        return result;
+        done(std::move(result));
+        return;
     }
     
     if (!validate_password(password)) {
         result.message = "Password must be at least 6 characters long";
-        return result;
+        done(std::move(result));
+        return;
     }
     
     // 检查用户名是否可用
     if (!is_username_available(username)) {
         result.message = "Username already exists";
-        return result;
+        done(std::move(result));
+        return;
     }
     
     // 检查邮箱是否可用
     if (!is_email_available(email)) {
         result.message = "Email already registered";
-        return result;
+        done(std::move(result));
+        return;
     }
     
-    // 创建用户
-    User user;
-    user.username = username;
-    user.password_hash = User::hash_password(password);
-    user.email = email;
-    user.status = UserStatus::OFFLINE;
-    
-    if (db->create_user(user)) {
-        result.success = true;
-        result.message = "User registered successfully";
-        result.user = db->get_user_by_username(username);
-    } else {
-        result.message = "Failed to create user";
+    // 在哈希线程池中计算密码哈希，完成后在哈希线程上创建用户
+    bool submitted = hasher->submit_hash(password, [this, username, email, done](std::string password_hash) {
+        RegisterResult result;
+        result.success = false;
+        
+        // 创建用户
+        User user;
+        user.username = username;
+        user.password_hash = std::move(password_hash);
+        user.email = email;
+        user.status = UserStatus::OFFLINE;
+        
+        if (user.password_hash.empty()) {
+            result.message = "Failed to create user";
+        } else if (db->create_user(user)) {
+            result.success = true;
+            result.message = "User registered successfully";
+            result.user = db->get_user_by_username(username);
+        } else {
+            result.message = "Failed to create user";
+        }
+        
+        done(std::move(result));
+    });
+    
+    if (!submitted) {
+        result.message = "Server busy, please try again later";
+        done(std::move(result));
     }
-    
-    return result;
 }
 
-AuthService::LoginResult AuthService::login_user(const std::string& username, 
-                                                const std::string& password) {
+void AuthService::login_user(const std::string& username, const std::string& password, LoginCallback done) {
     LoginResult result;
     result.success = false;
     
     // 获取用户
-    auto user = db->get_user_by_username(username);
+    std::shared_ptr<User> user = db->get_user_by_username(username);
     if (!user) {
         result.message = "User not found";
-        return result;
+        done(std::move(result));
+        return;
     }
     
-    // 验证密码
-    if (!user->verify_password(password)) {
-        result.message = "Invalid password";
-        return result;
+    // 在哈希线程池中验证密码，完成后在哈希线程上签发token
+    bool submitted = hasher->submit_verify(password, user->password_hash,
+                                           [this, user, password, done](bool verified) {
+        LoginResult result;
+        result.success = false;
+        
+        if (!verified) {
+            result.message = "Invalid password";
+            done(std::move(result));
+            return;
+        }
+        
+        // 旧格式哈希在登录成功后升级为scrypt；后台执行，不等待结果（队列已满时下次登录再升级）
+        if (User::needs_rehash(user->password_hash)) {
+            auto database = db;
+            int user_id = user->id;
+            hasher->submit_hash(password, [database, user_id](std::string upgraded) {
+                if (!upgraded.empty()) {
+                    database->update_user_password_hash(user_id, upgraded);
+                }
+            });
+        }
+        
+        // 更新用户状态为在线
+        db->update_user_status(user->id, UserStatus::ONLINE);
+        
+        // 生成Token
+        result.success = true;
+        result.message = "Login successful";
+        result.token = generate_token(*user);
+        result.user = std::make_unique<User>(*user);
+        
+        done(std::move(result));
+    });
+    
+    if (!submitted) {
+        result.message = "Server busy, please try again later";
+        done(std::move(result));
     }
-    
-    // 更新用户状态为在线
-    db->update_user_status(user->id, UserStatus::ONLINE);
-    
-    // 生成Token
-    result.success = true;
-    result.message = "Login successful";
-    result.token = generate_token(*user);
-    result.user = std::move(user);
-    
-    return result;
 }
 
 bool AuthService::logout_user(int user_id) {
-    return db->update_user_status(user_id, UserStatus::OFFLINE);
+    // 使该用户此前签发的所有token失效；持久化后重启也不会恢复
+    int64_t revoked_at = next_issue_stamp();
+    revocations.revoke_user(user_id, revoked_at);
+    bool persisted = db->save_revocation(user_id, revoked_at);
+    return db->update_user_status(user_id, UserStatus::OFFLINE) && persisted;
 }
 
 AuthService::TokenValidationResult AuthService::validate_token(const std::string& token) {
     TokenValidationResult result;
     result.valid = false;
     
-    int user_id;
-    std::time_t timestamp;
-    
-    if (!parse_simple_token(token, user_id, timestamp)) {
+    // 验证签名并解析声明（不访问数据库）
+    TokenSigner::Claims claims;
+    if (!signer.verify(token, claims)) {
         return result;
     }
     
-    // 检查token是否过期（24小时）
-    std::time_t now = std::time(nullptr);
-    if (now - timestamp > 86400) { // 24小时 = 86400秒
+    // 检查token是否过期
+    if (claims.expires_at < std::time(nullptr)) {
         return result;
     }
     
-    // 验证用户是否存在
-    auto user = db->get_user_by_id(user_id);
-    if (!user) {
+    // 已注销用户在注销前签发的token不再有效
+    if (revocations.is_revoked(claims.user_id, claims.issued_at_ms)) {
         return result;
     }
     
     result.valid = true;
-    result.user_id = user_id;
-    result.username = user->username;
+    result.user_id = claims.user_id;
+    result.username = claims.username;
     
     return result;
 }
 
 std::string AuthService::generate_token(const User& user) {
-    return generate_simple_token(user);
+    TokenSigner::Claims claims;
+    claims.user_id = user.id;
+    claims.username = user.username;
+    claims.issued_at_ms = next_issue_stamp();
+    claims.expires_at = std::time(nullptr) + TOKEN_TTL_SECONDS;
+    return signer.sign(claims);
 }
 
 bool AuthService::update_user_status(int user_id, UserStatus status) {
     return db->update_user_status(user_id, status);
 }
 
+size_t AuthService::evict_expired_sessions() {
+    int64_t now = now_ms();
+    db->delete_revocations_before(now - TOKEN_TTL_SECONDS * 1000);
+    return revocations.evict_expired(now, TOKEN_TTL_SECONDS * 1000);
+}
+
 bool AuthService::is_username_available(const std::string& username) {
     auto user = db->get_user_by_username(username);
     return user == nullptr;
@@ -184,3 +225,13 @@ bool AuthService::validate_email(const std::string& email) {
 bool AuthService::validate_password(const std::string& password) {
     return password.length() >= 6;
 }
+
+int64_t AuthService::next_issue_stamp() {
+    int64_t now = now_ms();
+    int64_t last = last_issue_stamp.load();
+    int64_t next;
+    do {
+        next = std::max(now, last + 1);
+    } while (!last_issue_stamp.compare_exchange_weak(last, next));
+    return next;
+}
@@ -0,0 +1,122 @@
+#include "../include/services/block_graph.h"
+#include <algorithm>
+#include <mutex>
+
+void BlockGraph::load(const std::vector<std::pair<int, int>>& blocks) {
+    std::unordered_map<int, std::vector<int>> forward;
+    std::unordered_map<int, std::vector<int>> reverse;
+    for (const auto& block : blocks) {
+        forward[block.first].push_back(block.second);
+        reverse[block.second].push_back(block.first);
+    }
+
+    auto freeze = [](std::unordered_map<int, std::vector<int>>& source) {
+        std::unordered_map<int, UserList> lists;
+        lists.reserve(source.size());
+        for (auto& pair : source) {
+            auto& ids = pair.second;
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            lists.emplace(pair.first, std::make_shared<const std::vector<int>>(std::move(ids)));
+        }
+        return lists;
+    };
+
+    auto new_blocked = freeze(forward);
+    auto new_blockers = freeze(reverse);
+    size_t count = 0;
+    for (const auto& pair : new_blocked) {
+        count += pair.second->size();
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    blocked = std::move(new_blocked);
+    blockers = std::move(new_blockers);
+    edge_count = count;
+}
+
+bool BlockGraph::block(int user_id, int blocked_user_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (!insert(blocked, user_id, blocked_user_id)) {
+        return false;
+    }
+    insert(blockers, blocked_user_id, user_id);
+    ++edge_count;
+    return true;
+}
+
+bool BlockGraph::unblock(int user_id, int blocked_user_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (!erase(blocked, user_id, blocked_user_id)) {
+        return false;
+    }
+    erase(blockers, blocked_user_id, user_id);
+    --edge_count;
+    return true;
+}
+
+bool BlockGraph::is_blocked(int user_id, int other_user_id) const {
+    return contains(blocked_by(user_id), other_user_id);
+}
+
+BlockGraph::UserList BlockGraph::blocked_by(int user_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return find(blocked, user_id);
+}
+
+BlockGraph::UserList BlockGraph::blockers_of(int user_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return find(blockers, user_id);
+}
+
+size_t BlockGraph::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return edge_count;
+}
+
+bool BlockGraph::contains(const UserList& list, int user_id) {
+    return list && std::binary_search(list->begin(), list->end(), user_id);
+}
+
+BlockGraph::UserList BlockGraph::find(const std::unordered_map<int, UserList>& lists, int user_id) {
+    auto it = lists.find(user_id);
+    return it != lists.end() ? it->second : nullptr;
+}
+
+bool BlockGraph::insert(std::unordered_map<int, UserList>& lists, int user_id, int value) {
+    UserList& list = lists[user_id];
+    std::vector<int> ids = list ? *list : std::vector<int>();
+
+    auto pos = std::lower_bound(ids.begin(), ids.end(), value);
+    if (pos != ids.end() && *pos == value) {
+        return false;
+    }
+    ids.insert(pos, value);
+    list = std::make_shared<const std::vector<int>>(std::move(ids));
+    return true;
+}
+
+bool BlockGraph::erase(std::unordered_map<int, UserList>& lists, int user_id, int value) {
+    auto it = lists.find(user_id);
+    if (it == lists.end()) {
+        return false;
+    }
+
+    const auto& current = *it->second;
+    auto pos = std::lower_bound(current.begin(), current.end(), value);
+    if (pos == current.end() || *pos != value) {
+        return false;
+    }
+
+    if (current.size() == 1) {
+        lists.erase(it);
+        return true;
+    }
+
+    std::vector<int> ids;
+    ids.reserve(current.size() - 1);
+    ids.insert(ids.end(), current.begin(), pos);
+    ids.insert(ids.end(), pos + 1, current.end());
+    it->second = std::make_shared<const std::vector<int>>(std::move(ids));
+    return true;
+}
@@ -1,36 +1,91 @@
 #include "../include/services/chat_service.h"
 #include "../include/database/database_manager.h"
 #include "../include/services/message_filter.h"
+#include "../include/services/message_writer.h"
+#include "../include/utils/metrics.h"
 #include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iterator>
 
 ChatService::ChatService(std::shared_ptr<DatabaseManager> database) 
-    : db(database), filter(std::make_shared<MessageFilter>()) {}
+    : db(database), filter(std::make_shared<MessageFilter>()),
+      writer(std::make_shared<MessageWriter>(database)) {
+    // 预热默认房间的内存缓冲区
+    room_history(Message::DEFAULT_ROOM, true);
+    
+    // 加载屏蔽关系
+    blocks.load(db->get_all_blocks());
+}
+
+ChatService::~ChatService() {
+    // 关闭前把队列中的消息全部落盘
+    writer->stop();
+}
 
 ChatService::SendMessageResult ChatService::send_message(int sender_id, const std::string& content, 
-                                                        MessageType type, int receiver_id) {
+                                                        MessageType type, int receiver_id,
+                                                        const std::string& sender_username,
+                                                        const std::string& room_id,
+                                                        const CommitCallback& on_committed) {
     SendMessageResult result;
     result.success = false;
     
     // 创建消息对象
     Message message(0, sender_id, content, type, receiver_id);
+    message.sender_username = sender_username;
+    message.room_id = room_id;
     
     // 验证消息
-    if (!message.is_valid()) {
+    if (!message.is_valid() || !Message::is_valid_room_name(room_id)) {
         result.message = "Invalid message";
         return result;
     }
     
     // 过滤敏感词
-    std::string filtered_content = filter->filter_message(content);
-    message.content = filtered_content;
+    static Histogram& filter_latency = Metrics::instance().histogram(
+        "chatroom_filter_seconds", "Sensitive word filtering latency per message");
+    {
+        ScopedTimer timer(filter_latency);
+        message.content = filter->filter_message(content);
+    }
+    
+    bool is_public = message.type == MessageType::PUBLIC;
+    if (is_public) {
+        // 在房间锁外创建并预热缓冲区，锁内通常只走查找路径
+        room_history(room_id, true);
+    }
+    
+    std::unique_lock<std::mutex> room_lock(room_locks[std::hash<std::string>()(room_id) % ROOM_LOCK_STRIPES],
+                                           std::defer_lock);
+    if (is_public) {
+        room_lock.lock();
+    }
+    
+    // 预分配ID后异步写入，广播无需等待落盘
+    message.id = db->reserve_message_id();
     
-    // 保存到数据库
-    if (db->save_message(message)) {
+    // 队列已满时退化为同步写入；先落盘队列中较小ID的消息，数据库中不会出现ID空洞
+    bool saved = writer->enqueue(message);
+    if (!saved) {
+        writer->flush();
+        saved = db->save_message(message);
+    }
+    
+    if (saved) {
         result.success = true;
         result.message = "Message sent successfully";
         
-        // 从数据库重新获取消息（包含ID等信息）
-        // 这里简化处理，实际应该返回完整的消息对象
+        // 写穿到房间的最近消息缓冲区（在锁内查找，预热后被淘汰时在此重新预热）
+        if (is_public) {
+            if (auto history = room_history(room_id, true)) {
+                history->push(message);
+            }
+        }
+        
+        if (on_committed) {
+            on_committed(message);
+        }
         result.processed_message = std::make_unique<Message>(message);
     } else {
         result.message = "Failed to save message";
@@ -39,77 +94,190 @@ ChatService::SendMessageResult ChatService::send_message(int sender_id, const st
     return result;
 }
 
-bool ChatService::recall_message(int message_id, int user_id) {
+bool ChatService::recall_message(int message_id, int user_id, std::string* room_id) {
+    // 被撤回的消息可能仍在写队列中，先确保其已落盘
+    writer->flush();
+    
     // 这里需要检查消息是否属于该用户，以及是否在可撤回时间内
-    return db->delete_message(message_id, user_id);
+    std::string message_room;
+    if (!db->delete_message(message_id, user_id, &message_room)) {
+        return false;
+    }
+    
+    if (auto history = room_history(message_room, false)) {
+        history->mark_deleted(message_id);
+    }
+    if (room_id) {
+        *room_id = message_room;
+    }
+    return true;
 }
 
-std::vector<Message> ChatService::get_chat_history(int user_id, int limit) {
-    auto messages = db->get_recent_messages(limit);
+ChatService::HistoryPage ChatService::get_chat_history_page(int user_id, const std::string& room_id,
+                                                          int after_id, int before_id, int limit) {
+    HistoryPage page;
+    limit = std::max(1, std::min(limit, MAX_HISTORY_PAGE));
+    
+    // 多取一条用于判断是否还有下一页
+    size_t fetch = static_cast<size_t>(limit) + 1;
+    std::vector<Message> messages;
+    
+    // 优先从内存缓冲区读取，超出范围时回退到数据库
+    auto history = room_history(room_id, false);
+    if (!history || !history->get_page(after_id, before_id, fetch, messages)) {
+        // 数据库路径需要看到写队列中尚未落盘的消息
+        writer->flush();
+        messages = db->get_messages_page(room_id, after_id, before_id, static_cast<int>(fetch));
+    }
+    
+    if (messages.size() > static_cast<size_t>(limit)) {
+        page.has_more = true;
+        // 向新方向翻页丢弃最新的一条，向旧方向翻页丢弃最旧的一条
+        if (after_id > 0) {
+            messages.pop_back();
+        } else {
+            messages.erase(messages.begin());
+        }
+    }
+    
+    if (!messages.empty()) {
+        page.first_id = messages.front().id;
+        page.last_id = messages.back().id;
+    }
     
     // 过滤被屏蔽用户的消息
-    auto blocked_users = db->get_blocked_users(user_id);
-    std::unordered_set<int> blocked_set(blocked_users.begin(), blocked_users.end());
+    if (auto blocked_users = blocks.blocked_by(user_id)) {
+        messages.erase(
+            std::remove_if(messages.begin(), messages.end(),
+                [&blocked_users](const Message& msg) {
+                    return BlockGraph::contains(blocked_users, msg.sender_id);
+                }),
+            messages.end()
+        );
+    }
     
-    messages.erase(
-        std::remove_if(messages.begin(), messages.end(),
-            [&blocked_set](const Message& msg) {
-                return blocked_set.find(msg.sender_id) != blocked_set.end();
-            }),
-        messages.end()
-    );
+    page.messages = std::move(messages);
+    return page;
+}
+
+std::vector<Message> ChatService::get_chat_history(int user_id, int limit) {
+    return get_chat_history_page(user_id, Message::DEFAULT_ROOM, 0, 0, limit).messages;
+}
+
+ChatService::HistoryPage ChatService::get_missed_messages(int user_id, const std::string& room_id,
+                                                        int last_message_id) {
+    HistoryPage delta;
+    delta.has_more = true;
+    delta.last_id = last_message_id;
     
-    return messages;
+    // 逐页向新消息方向读取，通常完全命中内存缓冲区
+    while (delta.has_more && static_cast<int>(delta.messages.size()) < MAX_CATCH_UP_MESSAGES) {
+        int remaining = MAX_CATCH_UP_MESSAGES - static_cast<int>(delta.messages.size());
+        auto page = get_chat_history_page(user_id, room_id, delta.last_id, 0, 
+                                          std::min(remaining, MAX_HISTORY_PAGE));
+        
+        if (page.last_id == 0) {
+            delta.has_more = false;
+            break;
+        }
+        
+        if (delta.first_id == 0) {
+            delta.first_id = page.first_id;
+        }
+        delta.last_id = page.last_id;
+        delta.has_more = page.has_more;
+        delta.messages.insert(delta.messages.end(),
+                              std::make_move_iterator(page.messages.begin()),
+                              std::make_move_iterator(page.messages.end()));
+    }
+    
+    return delta;
 }
 
-std::vector<Message> ChatService::get_private_chat_history(int user1_id, int user2_id, int limit) {
-    return db->get_private_messages(user1_id, user2_id, limit);
+std::vector<Message> ChatService::get_private_chat_history(int user1_id, int user2_id, int limit, int before_id) {
+    // 私聊消息同样经写队列异步落盘，查询前先落盘，刚发送的消息不会缺失
+    writer->flush();
+    return db->get_private_messages(user1_id, user2_id, limit, before_id);
 }
 
-bool ChatService::add_online_user(int user_id) {
-    std::lock_guard<std::mutex> lock(users_mutex);
-    online_users.insert(user_id);
+bool ChatService::add_online_user(int user_id, const std::string& username) {
+    if (!presence.join(user_id, username)) {
+        // 同一用户的其他连接仍在线，状态不变
+        return false;
+    }
     db->update_user_status(user_id, UserStatus::ONLINE);
     return true;
 }
 
 bool ChatService::remove_online_user(int user_id) {
-    std::lock_guard<std::mutex> lock(users_mutex);
-    online_users.erase(user_id);
+    if (!presence.leave(user_id)) {
+        return false;
+    }
     db->update_user_status(user_id, UserStatus::OFFLINE);
     return true;
 }
 
-std::vector<User> ChatService::get_online_users_list() {
-    std::lock_guard<std::mutex> lock(users_mutex);
-    std::vector<User> users;
-    
-    for (int user_id : online_users) {
-        auto user = db->get_user_by_id(user_id);
-        if (user) {
-            users.push_back(*user);
-        }
+bool ChatService::update_user_status(int user_id, UserStatus status) {
+    if (!db->update_user_status(user_id, status)) {
+        return false;
     }
-    
-    return users;
+    presence.set_status(user_id, status);
+    return true;
+}
+
+std::vector<User> ChatService::get_online_users_list() {
+    return presence.snapshot();
+}
+
+size_t ChatService::get_online_count() const {
+    return presence.get_online_count();
+}
+
+size_t ChatService::get_write_queue_depth() {
+    return writer->get_queue_depth();
 }
 
 bool ChatService::block_user(int user_id, int blocked_user_id) {
-    return db->block_user(user_id, blocked_user_id);
+    if (!db->block_user(user_id, blocked_user_id)) {
+        return false;
+    }
+    blocks.block(user_id, blocked_user_id);
+    return true;
 }
 
 bool ChatService::unblock_user(int user_id, int blocked_user_id) {
-    return db->unblock_user(user_id, blocked_user_id);
+    if (!db->unblock_user(user_id, blocked_user_id)) {
+        return false;
+    }
+    blocks.unblock(user_id, blocked_user_id);
+    return true;
 }
 
 std::vector<int> ChatService::get_blocked_users(int user_id) {
-    return db->get_blocked_users(user_id);
+    auto blocked_users = blocks.blocked_by(user_id);
+    return blocked_users ? *blocked_users : std::vector<int>();
+}
+
+BlockGraph::UserList ChatService::get_blockers(int user_id) {
+    return blocks.blockers_of(user_id);
 }
 
 bool ChatService::should_filter_message(int user_id, const Message& message) {
     return is_user_blocked(user_id, message.sender_id);
 }
 
+bool ChatService::cleanup_old_messages() {
+    // 与数据库保持一致：只保留3天内的消息
+    std::time_t cutoff = std::time(nullptr) - 3 * 24 * 3600;
+    {
+        std::shared_lock<std::shared_mutex> lock(rooms_mutex);
+        for (auto& pair : room_histories) {
+            pair.second.ring->evict_older_than(cutoff);
+        }
+    }
+    return db->cleanup_old_messages();
+}
+
 void ChatService::broadcast_system_message(const std::string& content) {
     Message system_msg(0, 0, content, MessageType::SYSTEM);
     db->save_message(system_msg);
@@ -123,8 +291,56 @@ void ChatService::send_user_leave_notification(const std::string& username) {
     broadcast_system_message(username + " 离开了聊天室");
 }
 
+std::shared_ptr<RecentMessageRing> ChatService::room_history(const std::string& room_id, bool create) {
+    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+    {
+        std::shared_lock<std::shared_mutex> lock(rooms_mutex);
+        auto it = room_histories.find(room_id);
+        if (it != room_histories.end()) {
+            it->second.last_used.store(now, std::memory_order_relaxed);
+            return it->second.ring;
+        }
+        if (!create) {
+            return nullptr;
+        }
+    }
+    
+    // 在锁外构建并预热，落盘和查询数据库期间不阻塞其他房间的读写；
+    // 先落盘写队列，保证缓冲区不会漏掉尚未写入的消息
+    auto history = std::make_shared<RecentMessageRing>();
+    writer->flush();
+    auto recent = db->get_recent_messages(room_id, static_cast<int>(history->get_capacity()));
+    history->warm(recent, recent.size() < history->get_capacity());
+    
+    std::unique_lock<std::shared_mutex> lock(rooms_mutex);
+    auto it = room_histories.find(room_id);
+    if (it != room_histories.end()) {
+        // 并发创建时使用先放入的缓冲区；预热后才写入的消息由发送方随后推入，push按ID去重
+        return it->second.ring;
+    }
+    
+    if (room_histories.size() >= MAX_CACHED_ROOMS) {
+        // 淘汰最久未使用的房间；房间数有上限，线性扫描只发生在创建新缓存时
+        auto victim = room_histories.end();
+        for (auto candidate = room_histories.begin(); candidate != room_histories.end(); ++candidate) {
+            if (candidate->first == Message::DEFAULT_ROOM) continue;
+            if (victim == room_histories.end() ||
+                candidate->second.last_used.load(std::memory_order_relaxed) <
+                    victim->second.last_used.load(std::memory_order_relaxed)) {
+                victim = candidate;
+            }
+        }
+        if (victim != room_histories.end()) {
+            room_histories.erase(victim);
+        }
+    }
+    
+    RoomHistory& entry = room_histories[room_id];
+    entry.ring = history;
+    entry.last_used.store(now, std::memory_order_relaxed);
+    return history;
+}
+
 bool ChatService::is_user_blocked(int user_id, int potential_blocked_user_id) {
-    auto blocked_users = db->get_blocked_users(user_id);
-    return std::find(blocked_users.begin(), blocked_users.end(), potential_blocked_user_id) 
-           != blocked_users.end();
+    return blocks.is_blocked(user_id, potential_blocked_user_id);
 }
@@ -1,77 +1,127 @@
 #include "../include/services/message_filter.h"
+#include "../include/utils/logger.h"
 #include <algorithm>
 #include <fstream>
-#include <iostream>
 
-MessageFilter::MessageFilter() {
+MessageFilter::MessageFilter(const std::string& words_file, std::chrono::seconds poll_interval)
+    : words_file(words_file), poll_interval(poll_interval), watching(false) {
     initialize_filter();
+    start_watching();
+}
+
+MessageFilter::~MessageFilter() {
+    stop_watching();
 }
 
 void MessageFilter::initialize_filter() {
-    auto default_words = get_default_sensitive_words();
-    for (const auto& word : default_words) {
-        sensitive_words.insert(word);
-    }
+    reload();
 }
 
 void MessageFilter::load_sensitive_words_from_file(const std::string& filename) {
-    std::ifstream file(filename);
-    std::string word;
-    while (std::getline(file, word)) {
-        if (!word.empty()) {
-            sensitive_words.insert(word);
-        }
+    std::vector<std::string> words;
+    if (!read_words_file(filename, words)) {
+        Logger::warn("Sensitive word file not found", {{"path", filename}});
+        return;
     }
+    
+    std::lock_guard<std::mutex> lock(update_mutex);
+    runtime_words.insert(runtime_words.end(), words.begin(), words.end());
+    publish_locked();
 }
 
 void MessageFilter::add_sensitive_word(const std::string& word) {
-    sensitive_words.insert(word);
+    if (word.empty()) return;
+    
+    std::lock_guard<std::mutex> lock(update_mutex);
+    runtime_words.push_back(word);
+    publish_locked();
 }
 
-std::string MessageFilter::filter_message(const std::string& message) {
-    return replace_sensitive_words(message);
+bool MessageFilter::reload() {
+    std::lock_guard<std::mutex> lock(update_mutex);
+    
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(words_file, ec);
+    if (!ec) {
+        loaded_mtime = mtime;
+    }
+    
+    publish_locked();
+    return !ec;
 }
 
-bool MessageFilter::contains_sensitive_content(const std::string& message) {
-    std::string lower_message = message;
-    std::transform(lower_message.begin(), lower_message.end(), lower_message.begin(), ::tolower);
+void MessageFilter::start_watching() {
+    std::lock_guard<std::mutex> lock(watcher_mutex);
+    if (watching) return;
     
-    for (const auto& word : sensitive_words) {
-        if (lower_message.find(word) != std::string::npos) {
-            return true;
-        }
+    watching = true;
+    watcher = std::thread([this]() { watch_loop(); });
+}
+
+void MessageFilter::stop_watching() {
+    {
+        std::lock_guard<std::mutex> lock(watcher_mutex);
+        if (!watching) return;
+        watching = false;
+    }
+    watcher_cv.notify_all();
+    
+    if (watcher.joinable()) {
+        watcher.join();
     }
-    return false;
+}
+
+std::string MessageFilter::filter_message(const std::string& message) {
+    auto dict = snapshot();
+    return replace_sensitive_words(*dict, message);
+}
+
+bool MessageFilter::contains_sensitive_content(const std::string& message) {
+    return snapshot()->matcher.contains_any(message);
 }
 
 int MessageFilter::get_filtered_words_count(const std::string& message) {
-    int count = 0;
-    std::string lower_message = message;
-    std::transform(lower_message.begin(), lower_message.end(), lower_message.begin(), ::tolower);
-    
-    for (const auto& word : sensitive_words) {
-        size_t pos = 0;
-        while ((pos = lower_message.find(word, pos)) != std::string::npos) {
-            count++;
-            pos += word.length();
-        }
-    }
-    return count;
+    return snapshot()->matcher.count_matches(message);
+}
+
+size_t MessageFilter::get_word_count() const {
+    return snapshot()->words.size();
 }
 
-std::string MessageFilter::replace_sensitive_words(const std::string& message) {
-    std::string result = message;
+std::string MessageFilter::replace_sensitive_words(const Dictionary& dict, const std::string& message) {
+    auto matches = dict.matcher.find_all(message);
+    if (matches.empty()) {
+        return message;
+    }
+    
+    // 命中按结束位置有序，较长的词可能起始于已处理的较短词之前（如"damn"与"goddamnit"）：
+    // 按起始位置排序后合并重叠区间，屏蔽区间的并集
+    std::sort(matches.begin(), matches.end(), [](const AhoCorasick::Match& a, const AhoCorasick::Match& b) {
+        return a.start < b.start;
+    });
+    
+    std::string result;
+    result.reserve(message.size());
     
-    for (const auto& word : sensitive_words) {
-        size_t pos = 0;
-        std::string replacement(word.length(), '*');
+    size_t copied = 0;
+    size_t i = 0;
+    while (i < matches.size()) {
+        size_t start = matches[i].start;
+        size_t end = start + matches[i].length;
+        for (++i; i < matches.size() && matches[i].start <= end; ++i) {
+            end = std::max(end, matches[i].start + matches[i].length);
+        }
         
-        // 不区分大小写的替换
-        while ((pos = result.find(word, pos)) != std::string::npos) {
-            result.replace(pos, word.length(), replacement);
-            pos += replacement.length();
+        // 每个被屏蔽的字符（而非字节）替换为一个'*'
+        result.append(message, copied, start - copied);
+        for (size_t pos = start; pos < end; ++pos) {
+            if ((static_cast<unsigned char>(message[pos]) & 0xC0) != 0x80) {
+                result.push_back('*');
+            }
         }
+        copied = end;
     }
+    result.append(message, copied, std::string::npos);
     
     return result;
 }
@@ -84,3 +134,77 @@ std::vector<std::string> MessageFilter::get_default_sensitive_words() {
         // 可以根据需要添加更多敏感词
     };
 }
+
+std::shared_ptr<const MessageFilter::Dictionary> MessageFilter::snapshot() const {
+    return std::atomic_load(&dictionary);
+}
+
+void MessageFilter::publish_locked() {
+    auto dict = std::make_shared<Dictionary>();
+    
+    for (const auto& word : get_default_sensitive_words()) {
+        dict->words.insert(word);
+    }
+    
+    std::vector<std::string> file_words;
+    if (read_words_file(words_file, file_words)) {
+        dict->words.insert(file_words.begin(), file_words.end());
+    }
+    
+    dict->words.insert(runtime_words.begin(), runtime_words.end());
+    
+    for (const auto& word : dict->words) {
+        dict->matcher.add_pattern(word);
+    }
+    dict->matcher.build();
+    
+    // 发布新快照；旧快照在最后一个读者释放后销毁
+    std::atomic_store(&dictionary, std::shared_ptr<const Dictionary>(std::move(dict)));
+}
+
+void MessageFilter::watch_loop() {
+    std::unique_lock<std::mutex> lock(watcher_mutex);
+    
+    while (watching) {
+        watcher_cv.wait_for(lock, poll_interval, [this]() { return !watching; });
+        if (!watching) break;
+        
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(words_file, ec);
+        if (ec) continue;
+        
+        bool changed;
+        {
+            std::lock_guard<std::mutex> update_lock(update_mutex);
+            changed = mtime != loaded_mtime;
+        }
+        
+        if (changed) {
+            // 重建期间不持有watcher_mutex，避免阻塞stop_watching
+            lock.unlock();
+            reload();
+            Logger::info("Reloaded sensitive words", {{"path", words_file}, {"words", get_word_count()}});
+            lock.lock();
+        }
+    }
+}
+
+bool MessageFilter::read_words_file(const std::string& filename, std::vector<std::string>& words) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    std::string word;
+    while (std::getline(file, word)) {
+        // 去除首尾空白，跳过空行和注释
+        auto begin = word.find_first_not_of(" \t\r\n");
+        if (begin == std::string::npos || word[begin] == '#') {
+            continue;
+        }
+        auto end = word.find_last_not_of(" \t\r\n");
+        words.push_back(word.substr(begin, end - begin + 1));
+    }
+    
+    return true;
+}
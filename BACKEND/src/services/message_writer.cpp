@@ -0,0 +1,120 @@
+#include "../include/services/message_writer.h"
+#include "../include/utils/logger.h"
+#include "../include/database/database_manager.h"
+#include <algorithm>
+
+MessageWriter::MessageWriter(std::shared_ptr<DatabaseManager> database, size_t capacity,
+                             size_t max_batch, std::chrono::milliseconds flush_interval)
+    : db(database), capacity(capacity), max_batch(max_batch), flush_interval(flush_interval),
+      enqueued_count(0), committed_count(0), failed_count(0), flush_requested(false), running(true) {
+    worker = std::thread([this]() { run(); });
+}
+
+MessageWriter::~MessageWriter() {
+    stop();
+}
+
+bool MessageWriter::enqueue(Message message) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (!running || queue.size() >= capacity) {
+            return false;
+        }
+        
+        queue.push_back(std::move(message));
+        ++enqueued_count;
+        
+        // 攒够一批时立即唤醒写线程，否则等待定时刷新
+        if (queue.size() < max_batch) {
+            return true;
+        }
+    }
+    
+    queue_cv.notify_one();
+    return true;
+}
+
+void MessageWriter::flush() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    uint64_t target = enqueued_count;
+    if (committed_count >= target) return;
+    
+    flush_requested = true;
+    queue_cv.notify_one();
+    flushed_cv.wait(lock, [this, target]() { return committed_count >= target; });
+}
+
+void MessageWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        running = false;
+    }
+    queue_cv.notify_one();
+    
+    if (worker.joinable()) {
+        worker.join();
+    }
+    flushed_cv.notify_all();
+}
+
+size_t MessageWriter::get_queue_depth() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return queue.size();
+}
+
+uint64_t MessageWriter::get_failed_count() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return failed_count;
+}
+
+void MessageWriter::run() {
+    std::vector<Message> batch;
+    batch.reserve(max_batch);
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait_for(lock, flush_interval, [this]() {
+                return !running || flush_requested || queue.size() >= max_batch;
+            });
+            
+            if (queue.empty()) {
+                flush_requested = false;
+                if (!running) break;
+                continue;
+            }
+            
+            size_t count = std::min(queue.size(), max_batch);
+            for (size_t i = 0; i < count; ++i) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        
+        write_batch(batch);
+        batch.clear();
+    }
+}
+
+void MessageWriter::write_batch(std::vector<Message>& batch) {
+    uint64_t failed = 0;
+    
+    if (!db->save_messages(batch)) {
+        // 事务失败时逐条重试，尽量保住其余消息
+        for (auto& message : batch) {
+            if (!db->save_message(message)) {
+                ++failed;
+            }
+        }
+        if (failed > 0) {
+            Logger::error("Failed to persist messages", {{"count", failed}});
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        committed_count += batch.size();
+        failed_count += failed;
+    }
+    flushed_cv.notify_all();
+}
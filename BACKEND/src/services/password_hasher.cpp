@@ -0,0 +1,77 @@
+#include "../include/services/password_hasher.h"
+#include "../include/models/user.h"
+#include <algorithm>
+
+PasswordHasher::PasswordHasher(size_t thread_count, size_t queue_capacity)
+    : queue_capacity(queue_capacity), running(true) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency() / 2);
+    }
+    
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+PasswordHasher::~PasswordHasher() {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        running = false;
+    }
+    tasks_cv.notify_all();
+    
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+bool PasswordHasher::submit_hash(const std::string& password, std::function<void(std::string)> done) {
+    return enqueue([password, done = std::move(done)]() {
+        done(User::hash_password(password));
+    });
+}
+
+bool PasswordHasher::submit_verify(const std::string& password, const std::string& password_hash,
+                                   std::function<void(bool)> done) {
+    return enqueue([password, password_hash, done = std::move(done)]() {
+        done(User::verify_password_hash(password, password_hash));
+    });
+}
+
+size_t PasswordHasher::get_queue_depth() {
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    return tasks.size();
+}
+
+bool PasswordHasher::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        if (!running || tasks.size() >= queue_capacity) {
+            return false;
+        }
+        tasks.push_back(std::move(task));
+    }
+    tasks_cv.notify_one();
+    return true;
+}
+
+void PasswordHasher::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(tasks_mutex);
+            tasks_cv.wait(lock, [this]() { return !running || !tasks.empty(); });
+            
+            if (!running && tasks.empty()) {
+                return;
+            }
+            
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        
+        task();
+    }
+}
@@ -0,0 +1,63 @@
+#include "../include/services/presence_tracker.h"
+#include <mutex>
+
+bool PresenceTracker::join(int user_id, const std::string& username) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    
+    auto result = online.try_emplace(user_id, Entry{username, UserStatus::ONLINE, 0});
+    ++result.first->second.connections;
+    return result.second;
+}
+
+bool PresenceTracker::leave(int user_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    
+    auto it = online.find(user_id);
+    if (it == online.end()) {
+        return false;
+    }
+    
+    if (--it->second.connections > 0) {
+        return false;
+    }
+    
+    online.erase(it);
+    return true;
+}
+
+bool PresenceTracker::set_status(int user_id, UserStatus status) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    
+    auto it = online.find(user_id);
+    if (it == online.end()) {
+        return false;
+    }
+    
+    it->second.status = status;
+    return true;
+}
+
+bool PresenceTracker::is_online(int user_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return online.find(user_id) != online.end();
+}
+
+size_t PresenceTracker::get_online_count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return online.size();
+}
+
+std::vector<User> PresenceTracker::snapshot() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    
+    std::vector<User> users;
+    users.reserve(online.size());
+    for (const auto& pair : online) {
+        User user;
+        user.id = pair.first;
+        user.username = pair.second.username;
+        user.status = pair.second.status;
+        users.push_back(std::move(user));
+    }
+    return users;
+}
@@ -0,0 +1,110 @@
+#include "../include/services/recent_message_ring.h"
+#include <algorithm>
+#include <climits>
+#include <mutex>
+
+RecentMessageRing::RecentMessageRing(size_t capacity)
+    : capacity(capacity > 0 ? capacity : 1), live_count(0), complete(true) {}
+
+void RecentMessageRing::warm(const std::vector<Message>& recent, bool is_complete) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    
+    messages.assign(recent.begin(), recent.end());
+    live_count = 0;
+    for (const auto& message : messages) {
+        if (!message.is_deleted) ++live_count;
+    }
+    complete = is_complete;
+    trim_locked();
+}
+
+void RecentMessageRing::push(const Message& message) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    
+    // ChatService在房间锁内按ID顺序写入，通常直接追加到末尾；从尾部查找插入位置只是防御
+    auto it = messages.end();
+    while (it != messages.begin() && std::prev(it)->id > message.id) {
+        --it;
+    }
+    if (it != messages.begin() && std::prev(it)->id == message.id) {
+        // 预热时已从数据库读到该消息
+        return;
+    }
+    messages.insert(it, message);
+    
+    if (!message.is_deleted) ++live_count;
+    trim_locked();
+}
+
+bool RecentMessageRing::mark_deleted(int message_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    
+    for (auto it = messages.rbegin(); it != messages.rend(); ++it) {
+        if (it->id == message_id) {
+            if (!it->is_deleted) {
+                it->is_deleted = true;
+                --live_count;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void RecentMessageRing::evict_older_than(std::time_t cutoff) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    
+    while (!messages.empty() && messages.front().timestamp < cutoff) {
+        if (!messages.front().is_deleted) --live_count;
+        messages.pop_front();
+    }
+}
+
+bool RecentMessageRing::get_page(int after_id, int before_id, size_t limit,
+                                 std::vector<Message>& out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    
+    int upper = before_id > 0 ? before_id : INT_MAX;
+    auto by_id = [](const Message& message, int id) { return message.id < id; };
+    out.clear();
+    
+    if (after_id > 0) {
+        // 缓冲区包含ID不小于首条消息的全部公共消息，游标之后的部分必须完全落在缓冲区内
+        if (!complete && (messages.empty() || messages.front().id > after_id + 1)) {
+            return false;
+        }
+        
+        auto it = std::lower_bound(messages.begin(), messages.end(), after_id + 1, by_id);
+        for (; it != messages.end() && it->id < upper && out.size() < limit; ++it) {
+            if (!it->is_deleted) {
+                out.push_back(*it);
+            }
+        }
+        return true;
+    }
+    
+    // 从游标往回取limit条，不足时只有缓冲区包含全部历史才能确定没有更早的消息
+    auto it = std::lower_bound(messages.begin(), messages.end(), upper, by_id);
+    while (it != messages.begin() && out.size() < limit) {
+        --it;
+        if (!it->is_deleted) {
+            out.push_back(*it);
+        }
+    }
+    
+    if (out.size() < limit && !complete) {
+        out.clear();
+        return false;
+    }
+    
+    std::reverse(out.begin(), out.end());
+    return true;
+}
+
+void RecentMessageRing::trim_locked() {
+    while (messages.size() > capacity) {
+        if (!messages.front().is_deleted) --live_count;
+        messages.pop_front();
+        complete = false;
+    }
+}
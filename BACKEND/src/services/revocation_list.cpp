@@ -0,0 +1,35 @@
+#include "../include/services/revocation_list.h"
+#include <mutex>
+
+void RevocationList::revoke_user(int user_id, int64_t revoked_at_ms) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    revoked_before_ms[user_id] = revoked_at_ms;
+    entry_count = revoked_before_ms.size();
+}
+
+bool RevocationList::is_revoked(int user_id, int64_t issued_at_ms) const {
+    if (entry_count.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = revoked_before_ms.find(user_id);
+    return it != revoked_before_ms.end() && issued_at_ms <= it->second;
+}
+
+size_t RevocationList::evict_expired(int64_t now_ms, int64_t token_ttl_ms) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    size_t evicted = 0;
+    
+    for (auto it = revoked_before_ms.begin(); it != revoked_before_ms.end();) {
+        if (now_ms - it->second > token_ttl_ms) {
+            it = revoked_before_ms.erase(it);
+            ++evicted;
+        } else {
+            ++it;
+        }
+    }
+    
+    entry_count = revoked_before_ms.size();
+    return evicted;
+}
@@ -0,0 +1,182 @@
+#include "../include/services/token_signer.h"
+#include "../include/utils/logger.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+const char BASE64URL_ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+std::string base64url_encode(const unsigned char* data, size_t length) {
+    std::string out;
+    out.reserve((length + 2) / 3 * 4);
+    
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (size_t i = 0; i < length; ++i) {
+        buffer = (buffer << 8) | data[i];
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            out.push_back(BASE64URL_ALPHABET[(buffer >> bits) & 0x3F]);
+        }
+    }
+    if (bits > 0) {
+        out.push_back(BASE64URL_ALPHABET[(buffer << (6 - bits)) & 0x3F]);
+    }
+    return out;
+}
+
+bool base64url_decode(const std::string& in, std::string& out) {
+    out.clear();
+    out.reserve(in.size() * 3 / 4);
+    
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char c : in) {
+        int value;
+        if (c >= 'A' && c <= 'Z') value = c - 'A';
+        else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') value = c - '0' + 52;
+        else if (c == '-') value = 62;
+        else if (c == '_') value = 63;
+        else return false;
+        
+        buffer = (buffer << 6) | static_cast<uint32_t>(value);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>((buffer >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+std::string hmac_sha256(const std::string& key, const std::string& data) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    
+    HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()),
+         reinterpret_cast<const unsigned char*>(data.data()), data.size(),
+         digest, &digest_length);
+    
+    return std::string(reinterpret_cast<const char*>(digest), digest_length);
+}
+
+} // namespace
+
+TokenSigner::TokenSigner() {
+    load_keys_from_env();
+    
+    if (!snapshot()) {
+        unsigned char secret[32];
+        RAND_bytes(secret, sizeof(secret));
+        add_key("ephemeral", std::string(reinterpret_cast<const char*>(secret), sizeof(secret)), true);
+        Logger::warn("CHATROOM_TOKEN_KEYS not set, tokens will not survive a restart");
+    }
+}
+
+void TokenSigner::add_key(const std::string& kid, const std::string& secret, bool make_active) {
+    if (kid.empty() || secret.empty() || kid.find('.') != std::string::npos) return;
+    
+    std::lock_guard<std::mutex> lock(update_mutex);
+    auto current = snapshot();
+    auto updated = current ? std::make_shared<KeySet>(*current) : std::make_shared<KeySet>();
+    
+    updated->keys[kid] = secret;
+    if (make_active || updated->active_kid.empty()) {
+        updated->active_kid = kid;
+    }
+    
+    std::atomic_store(&keyset, std::shared_ptr<const KeySet>(std::move(updated)));
+}
+
+std::string TokenSigner::sign(const Claims& claims) const {
+    auto keys = snapshot();
+    const std::string& secret = keys->keys.at(keys->active_kid);
+    
+    // 用户名放在最后，允许其中包含分隔符
+    std::ostringstream payload;
+    payload << claims.user_id << '|' << claims.issued_at_ms << '|' << claims.expires_at << '|' << claims.username;
+    std::string payload_str = payload.str();
+    
+    std::string signing_input = keys->active_kid + "." +
+        base64url_encode(reinterpret_cast<const unsigned char*>(payload_str.data()), payload_str.size());
+    std::string signature = hmac_sha256(secret, signing_input);
+    
+    return signing_input + "." +
+        base64url_encode(reinterpret_cast<const unsigned char*>(signature.data()), signature.size());
+}
+
+bool TokenSigner::verify(const std::string& token, Claims& claims) const {
+    size_t first_dot = token.find('.');
+    size_t second_dot = token.rfind('.');
+    if (first_dot == std::string::npos || first_dot == second_dot) {
+        return false;
+    }
+    
+    auto keys = snapshot();
+    auto key_it = keys->keys.find(token.substr(0, first_dot));
+    if (key_it == keys->keys.end()) {
+        return false;
+    }
+    
+    std::string signature;
+    if (!base64url_decode(token.substr(second_dot + 1), signature)) {
+        return false;
+    }
+    
+    std::string expected = hmac_sha256(key_it->second, token.substr(0, second_dot));
+    if (signature.size() != expected.size() ||
+        CRYPTO_memcmp(signature.data(), expected.data(), expected.size()) != 0) {
+        return false;
+    }
+    
+    std::string payload;
+    if (!base64url_decode(token.substr(first_dot + 1, second_dot - first_dot - 1), payload)) {
+        return false;
+    }
+    
+    size_t p1 = payload.find('|');
+    size_t p2 = payload.find('|', p1 == std::string::npos ? p1 : p1 + 1);
+    size_t p3 = payload.find('|', p2 == std::string::npos ? p2 : p2 + 1);
+    if (p1 == std::string::npos || p2 == std::string::npos || p3 == std::string::npos) {
+        return false;
+    }
+    
+    try {
+        claims.user_id = std::stoi(payload.substr(0, p1));
+        claims.issued_at_ms = std::stoll(payload.substr(p1 + 1, p2 - p1 - 1));
+        claims.expires_at = std::stoll(payload.substr(p2 + 1, p3 - p2 - 1));
+        claims.username = payload.substr(p3 + 1);
+    } catch (...) {
+        return false;
+    }
+    
+    return true;
+}
+
+std::shared_ptr<const TokenSigner::KeySet> TokenSigner::snapshot() const {
+    return std::atomic_load(&keyset);
+}
+
+void TokenSigner::load_keys_from_env() {
+    const char* env = std::getenv("CHATROOM_TOKEN_KEYS");
+    if (!env) return;
+    
+    std::istringstream entries(env);
+    std::string entry;
+    bool first = true;
+    while (std::getline(entries, entry, ',')) {
+        size_t colon = entry.find(':');
+        if (colon == std::string::npos) continue;
+        
+        add_key(entry.substr(0, colon), entry.substr(colon + 1), first);
+        first = false;
+    }
+}
@@ -0,0 +1,124 @@
+#include "../include/utils/aho_corasick.h"
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+AhoCorasick::AhoCorasick() : nodes(1), pattern_count(0), built(false) {
+    root_next.fill(0);
+}
+
+void AhoCorasick::add_pattern(const std::string& pattern) {
+    if (pattern.empty() || pattern.size() > std::numeric_limits<uint16_t>::max()) {
+        return;
+    }
+    
+    int32_t state = 0;
+    for (unsigned char raw : pattern) {
+        unsigned char c = fold(raw);
+        int32_t next = find_edge(state, c);
+        if (next < 0) {
+            next = static_cast<int32_t>(nodes.size());
+            nodes.emplace_back();
+            auto& edges = nodes[state].edges;
+            auto pos = std::lower_bound(edges.begin(), edges.end(), std::make_pair(c, int32_t(0)),
+                [](const std::pair<unsigned char, int32_t>& a, const std::pair<unsigned char, int32_t>& b) {
+                    return a.first < b.first;
+                });
+            edges.insert(pos, {c, next});
+        }
+        state = next;
+    }
+    
+    if (nodes[state].matches == 0) {
+        ++pattern_count;
+    }
+    nodes[state].length = static_cast<uint16_t>(pattern.size());
+    nodes[state].matches = 1;
+    built = false;
+}
+
+void AhoCorasick::build() {
+    root_next.fill(0);
+    for (const auto& edge : nodes[0].edges) {
+        root_next[edge.first] = edge.second;
+    }
+    
+    // 广度优先计算失配指针，并沿失配链合并输出
+    std::queue<int32_t> pending;
+    for (const auto& edge : nodes[0].edges) {
+        nodes[edge.second].fail = 0;
+        nodes[edge.second].output = 0;
+        pending.push(edge.second);
+    }
+    
+    while (!pending.empty()) {
+        int32_t current = pending.front();
+        pending.pop();
+        
+        for (const auto& edge : nodes[current].edges) {
+            int32_t child = edge.second;
+            int32_t fail = nodes[current].fail;
+            int32_t target = next_state(fail, edge.first);
+            
+            nodes[child].fail = target;
+            nodes[child].output = nodes[target].length != 0 ? target : nodes[target].output;
+            nodes[child].matches = static_cast<uint16_t>(
+                std::min<int>(nodes[child].matches + nodes[target].matches,
+                              std::numeric_limits<uint16_t>::max()));
+            pending.push(child);
+        }
+    }
+    
+    built = true;
+}
+
+std::vector<AhoCorasick::Match> AhoCorasick::find_all(const std::string& text) const {
+    std::vector<Match> result;
+    scan(text, [&result](const Match& match) {
+        result.push_back(match);
+        return true;
+    });
+    return result;
+}
+
+bool AhoCorasick::contains_any(const std::string& text) const {
+    bool found = false;
+    scan(text, [&found](const Match&) {
+        found = true;
+        return false; // 命中即停止
+    });
+    return found;
+}
+
+int AhoCorasick::count_matches(const std::string& text) const {
+    if (!built || pattern_count == 0) return 0;
+    
+    int count = 0;
+    int32_t state = 0;
+    for (unsigned char c : text) {
+        state = next_state(state, fold(c));
+        count += nodes[state].matches;
+    }
+    return count;
+}
+
+int32_t AhoCorasick::find_edge(int32_t node, unsigned char c) const {
+    const auto& edges = nodes[node].edges;
+    auto it = std::lower_bound(edges.begin(), edges.end(), std::make_pair(c, int32_t(0)),
+        [](const std::pair<unsigned char, int32_t>& a, const std::pair<unsigned char, int32_t>& b) {
+            return a.first < b.first;
+        });
+    if (it != edges.end() && it->first == c) {
+        return it->second;
+    }
+    return -1;
+}
+
+int32_t AhoCorasick::next_state(int32_t state, unsigned char c) const {
+    while (state != 0) {
+        int32_t next = find_edge(state, c);
+        if (next >= 0) return next;
+        state = nodes[state].fail;
+    }
+    return root_next[c];
+}
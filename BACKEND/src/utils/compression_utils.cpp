@@ -0,0 +1,22 @@
+#include "../include/utils/compression_utils.h"
+#include <zlib.h>
+
+bool CompressionUtils::deflate_raw(const std::string& input, std::string& output, int level) {
+    z_stream stream{};
+    // 负的windowBits表示原始DEFLATE流
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    
+    output.resize(deflateBound(&stream, static_cast<uLong>(input.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+    
+    int rc = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    
+    return rc == Z_STREAM_END;
+}
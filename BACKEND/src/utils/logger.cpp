@@ -0,0 +1,358 @@
+#include "../include/utils/logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t RING_CAPACITY = 256 * 1024;
+constexpr size_t MAX_RECORD_BODY = 4096;
+constexpr std::chrono::milliseconds DRAIN_INTERVAL{20};
+
+struct RecordHeader {
+    uint32_t length; // 正文字节数
+    uint8_t level;
+    int64_t timestamp_ms;
+};
+
+// 单生产者（所属线程）单消费者（输出线程）的字节环形缓冲区
+// head/tail为累计字节数，取模得到位置
+struct ThreadRing {
+    char data[RING_CAPACITY];
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+    std::atomic<bool> orphaned{false}; // 所属线程已退出，取空后回收
+
+    bool push(const RecordHeader& header, const char* body) {
+        size_t size = sizeof(header) + header.length;
+        size_t write = head.load(std::memory_order_relaxed);
+        size_t read = tail.load(std::memory_order_acquire);
+        if (RING_CAPACITY - (write - read) < size) {
+            return false;
+        }
+
+        copy_in(write, reinterpret_cast<const char*>(&header), sizeof(header));
+        copy_in(write + sizeof(header), body, header.length);
+        head.store(write + size, std::memory_order_release);
+        return true;
+    }
+
+    void copy_in(size_t position, const char* bytes, size_t size) {
+        size_t offset = position % RING_CAPACITY;
+        size_t first = std::min(size, RING_CAPACITY - offset);
+        std::memcpy(data + offset, bytes, first);
+        std::memcpy(data, bytes + first, size - first);
+    }
+
+    void copy_out(size_t position, char* bytes, size_t size) const {
+        size_t offset = position % RING_CAPACITY;
+        size_t first = std::min(size, RING_CAPACITY - offset);
+        std::memcpy(bytes, data + offset, first);
+        std::memcpy(bytes + first, data, size - first);
+    }
+};
+
+const char* level_name(uint8_t level) {
+    switch (static_cast<LogLevel>(level)) {
+        case LogLevel::DEBUG: return "debug";
+        case LogLevel::INFO: return "info";
+        case LogLevel::WARN: return "warn";
+        case LogLevel::ERROR: return "error";
+    }
+    return "info";
+}
+
+class LogSink {
+public:
+    LogLevel min_level = LogLevel::INFO;
+    uint32_t sample_every = 100;
+    std::atomic<uint64_t> dropped{0};
+
+    static LogSink& instance() {
+        static LogSink sink;
+        return sink;
+    }
+
+    ThreadRing& thread_ring() {
+        // 线程退出时标记缓冲区，由输出线程取空后回收
+        struct Holder {
+            std::shared_ptr<ThreadRing> ring;
+            ~Holder() {
+                if (ring) ring->orphaned.store(true);
+            }
+        };
+        thread_local Holder holder;
+
+        if (!holder.ring) {
+            holder.ring = std::make_shared<ThreadRing>();
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            rings.push_back(holder.ring);
+        }
+        return *holder.ring;
+    }
+
+    void drain() {
+        std::lock_guard<std::mutex> drain_lock(drain_mutex);
+
+        std::vector<std::shared_ptr<ThreadRing>> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            snapshot = rings;
+        }
+
+        out_buffer.clear();
+        err_buffer.clear();
+        for (const auto& ring : snapshot) {
+            bool orphaned = ring->orphaned.load();
+            size_t write = ring->head.load(std::memory_order_acquire);
+            size_t read = ring->tail.load(std::memory_order_relaxed);
+
+            while (read < write) {
+                RecordHeader header;
+                ring->copy_out(read, reinterpret_cast<char*>(&header), sizeof(header));
+                std::string& out = header.level >= static_cast<uint8_t>(LogLevel::WARN) ? err_buffer : out_buffer;
+                append_prefix(out, header);
+                size_t start = out.size();
+                out.resize(start + header.length);
+                ring->copy_out(read + sizeof(header), &out[start], header.length);
+                out.push_back('\n');
+                read += sizeof(header) + header.length;
+            }
+            ring->tail.store(read, std::memory_order_release);
+
+            if (orphaned) {
+                // 标记前写入的记录已在本轮取出
+                std::lock_guard<std::mutex> lock(rings_mutex);
+                rings.erase(std::remove(rings.begin(), rings.end(), ring), rings.end());
+            }
+        }
+
+        uint64_t lost = dropped.exchange(0);
+        if (lost > 0) {
+            RecordHeader header{0, static_cast<uint8_t>(LogLevel::WARN), now_ms()};
+            append_prefix(err_buffer, header);
+            err_buffer += "msg=\"log records dropped\" count=" + std::to_string(lost) + "\n";
+            dropped_total.fetch_add(lost);
+        }
+
+        if (!out_buffer.empty()) {
+            std::fwrite(out_buffer.data(), 1, out_buffer.size(), stdout);
+            std::fflush(stdout);
+        }
+        if (!err_buffer.empty()) {
+            std::fwrite(err_buffer.data(), 1, err_buffer.size(), stderr);
+            std::fflush(stderr);
+        }
+    }
+
+    uint64_t get_dropped_total() const {
+        return dropped_total.load() + dropped.load();
+    }
+
+    static int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+
+    // 同一时刻只有一个消费者（输出线程或flush调用方）
+    std::mutex drain_mutex;
+    std::string out_buffer;
+    std::string err_buffer;
+    std::atomic<uint64_t> dropped_total{0};
+
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    bool running = true;
+    std::thread worker;
+
+    LogSink() {
+        if (const char* level = std::getenv("CHATROOM_LOG_LEVEL")) {
+            std::string value(level);
+            if (value == "debug") min_level = LogLevel::DEBUG;
+            else if (value == "warn") min_level = LogLevel::WARN;
+            else if (value == "error") min_level = LogLevel::ERROR;
+        }
+        if (const char* sample = std::getenv("CHATROOM_LOG_SAMPLE")) {
+            long value = std::strtol(sample, nullptr, 10);
+            if (value > 0) sample_every = static_cast<uint32_t>(value);
+        }
+
+        worker = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            while (running) {
+                wake_cv.wait_for(lock, DRAIN_INTERVAL);
+                lock.unlock();
+                drain();
+                lock.lock();
+            }
+        });
+    }
+
+    ~LogSink() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            running = false;
+        }
+        wake_cv.notify_one();
+        if (worker.joinable()) {
+            worker.join();
+        }
+        drain();
+    }
+
+    static void append_prefix(std::string& out, const RecordHeader& header) {
+        std::time_t seconds = static_cast<std::time_t>(header.timestamp_ms / 1000);
+        std::tm utc;
+        gmtime_r(&seconds, &utc);
+
+        char buffer[48];
+        size_t length = std::strftime(buffer, sizeof(buffer), "ts=%Y-%m-%dT%H:%M:%S", &utc);
+        length += std::snprintf(buffer + length, sizeof(buffer) - length, ".%03dZ level=",
+                                static_cast<int>(header.timestamp_ms % 1000));
+        out.append(buffer, length);
+        out += level_name(header.level);
+        out.push_back(' ');
+    }
+};
+
+} // namespace
+
+bool Logger::enabled(LogLevel level) {
+    return level >= LogSink::instance().min_level;
+}
+
+void Logger::log(LogLevel level, std::string_view message, std::initializer_list<LogField> fields) {
+    LogSink& sink = LogSink::instance();
+    if (level < sink.min_level) {
+        return;
+    }
+
+    // 在调用线程格式化正文，复用线程局部缓冲区，稳定后不再分配
+    thread_local std::string body;
+    body.clear();
+    body += "msg=";
+    append_value(body, message);
+    for (const auto& field : fields) {
+        body.push_back(' ');
+        format_field(body, field);
+    }
+    if (body.size() > MAX_RECORD_BODY) {
+        body.resize(MAX_RECORD_BODY);
+    }
+
+    RecordHeader header{static_cast<uint32_t>(body.size()), static_cast<uint8_t>(level), LogSink::now_ms()};
+    if (!sink.thread_ring().push(header, body.data())) {
+        sink.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Logger::debug(std::string_view message, std::initializer_list<LogField> fields) {
+    log(LogLevel::DEBUG, message, fields);
+}
+
+void Logger::info(std::string_view message, std::initializer_list<LogField> fields) {
+    log(LogLevel::INFO, message, fields);
+}
+
+void Logger::warn(std::string_view message, std::initializer_list<LogField> fields) {
+    log(LogLevel::WARN, message, fields);
+}
+
+void Logger::error(std::string_view message, std::initializer_list<LogField> fields) {
+    log(LogLevel::ERROR, message, fields);
+}
+
+void Logger::debug_sampled(std::string_view message, std::initializer_list<LogField> fields) {
+    LogSink& sink = LogSink::instance();
+    if (LogLevel::DEBUG < sink.min_level) {
+        return;
+    }
+
+    thread_local uint32_t counter = 0;
+    if (++counter < sink.sample_every) {
+        return;
+    }
+    counter = 0;
+    log(LogLevel::DEBUG, message, fields);
+}
+
+void Logger::flush() {
+    LogSink::instance().drain();
+}
+
+uint64_t Logger::get_dropped_count() {
+    return LogSink::instance().get_dropped_total();
+}
+
+void Logger::format_field(std::string& out, const LogField& field) {
+    out += field.key;
+    out.push_back('=');
+
+    char buffer[32];
+    switch (field.kind) {
+        case LogField::Kind::STRING:
+            append_value(out, field.text);
+            return;
+        case LogField::Kind::INT:
+            std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(field.integer));
+            break;
+        case LogField::Kind::UINT:
+            std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(field.unsigned_integer));
+            break;
+        case LogField::Kind::DOUBLE:
+            std::snprintf(buffer, sizeof(buffer), "%g", field.real);
+            break;
+        case LogField::Kind::BOOL:
+            out += field.boolean ? "true" : "false";
+            return;
+    }
+    out += buffer;
+}
+
+void Logger::append_value(std::string& out, std::string_view value) {
+    // 含空格、引号、等号或控制字符的值加引号并转义
+    bool quote = value.empty();
+    for (char c : value) {
+        if (c == ' ' || c == '"' || c == '=' || c == '\\' || static_cast<unsigned char>(c) < 0x20) {
+            quote = true;
+            break;
+        }
+    }
+    if (!quote) {
+        out.append(value.data(), value.size());
+        return;
+    }
+
+    out.push_back('"');
+    for (char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\x%02x", static_cast<unsigned char>(c));
+                    out += escaped;
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    out.push_back('"');
+}
@@ -0,0 +1,163 @@
+#include "../include/utils/metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+std::string format_number(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+// 拼接标签集合，例如 {method="x",le="0.5"}
+std::string label_set(const std::string& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) return "";
+    if (labels.empty()) return "{" + extra + "}";
+    if (extra.empty()) return "{" + labels + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+} // namespace
+
+size_t Histogram::bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    if (value >> MAX_VALUE_BITS) {
+        return BUCKETS - 1;
+    }
+
+    // value位于[2^k, 2^(k+1))，该区间按高SUB_BUCKET_BITS位后的位数线性分桶
+    size_t k = 63 - static_cast<size_t>(__builtin_clzll(value));
+    size_t shift = k - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<size_t>(value >> shift) - SUB_BUCKETS;
+}
+
+uint64_t Histogram::bucket_bound(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    size_t shift = index / SUB_BUCKETS - 1;
+    uint64_t sub = index % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void Histogram::observe(uint64_t value) {
+    buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+ScopedTimer::~ScopedTimer() {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    histogram.observe(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Entry& Metrics::find_or_add(Kind kind, const std::string& name, const std::string& help,
+                                     const std::string& labels) {
+    for (auto& entry : entries) {
+        if (entry.kind == kind && entry.name == name && entry.labels == labels) {
+            return entry;
+        }
+    }
+
+    entries.emplace_back();
+    Entry& entry = entries.back();
+    entry.kind = kind;
+    entry.name = name;
+    entry.help = help;
+    entry.labels = labels;
+    return entry;
+}
+
+Counter& Metrics::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return find_or_add(Kind::COUNTER, name, help, labels).counter;
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::string& help, const std::string& labels,
+                              Unit unit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = find_or_add(Kind::HISTOGRAM, name, help, labels);
+    entry.unit = unit;
+    return entry.histogram;
+}
+
+void Metrics::callback(const std::string& name, const std::string& help, std::function<double()> read,
+                       bool counter_type, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = find_or_add(Kind::CALLBACK, name, help, labels);
+    entry.read = std::move(read);
+    entry.counter_type = counter_type;
+}
+
+std::string Metrics::render() const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // 同名指标必须连续输出，按名称稳定排序（同名内保持注册顺序）
+    std::vector<const Entry*> sorted;
+    sorted.reserve(entries.size());
+    for (const auto& entry : entries) {
+        sorted.push_back(&entry);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) {
+        return a->name < b->name;
+    });
+
+    std::string out;
+    const std::string* previous = nullptr;
+    for (const Entry* entry : sorted) {
+        if (!previous || *previous != entry->name) {
+            const char* type = entry->kind == Kind::HISTOGRAM ? "histogram" :
+                               (entry->kind == Kind::COUNTER || entry->counter_type) ? "counter" : "gauge";
+            out += "# HELP " + entry->name + " " + entry->help + "\n";
+            out += "# TYPE " + entry->name + " " + type + "\n";
+            previous = &entry->name;
+        }
+
+        switch (entry->kind) {
+            case Kind::COUNTER:
+                out += entry->name + label_set(entry->labels) + " " +
+                       std::to_string(entry->counter.get()) + "\n";
+                break;
+            case Kind::CALLBACK:
+                out += entry->name + label_set(entry->labels) + " " +
+                       format_number(entry->read ? entry->read() : 0) + "\n";
+                break;
+            case Kind::HISTOGRAM: {
+                const Histogram& histogram = entry->histogram;
+                double scale = entry->unit == Unit::MICROSECONDS ? 1e-6 : 1.0;
+                // 只输出有过观测的桶及其下一侧相邻桶的边界（保证插值区间只跨一个桶）；
+                // 计数只增不减，输出的边界集合随时间只会增加
+                uint64_t cumulative = 0;
+                uint64_t next = histogram.get_bucket(0);
+                for (size_t i = 0; i < Histogram::BUCKETS; ++i) {
+                    uint64_t current = next;
+                    next = i + 1 < Histogram::BUCKETS ? histogram.get_bucket(i + 1) : 0;
+                    cumulative += current;
+                    bool last = i + 1 == Histogram::BUCKETS;
+                    if (!last && current == 0 && next == 0) continue;
+                    std::string le = last ? "+Inf" :
+                                     format_number(static_cast<double>(Histogram::bucket_bound(i)) * scale);
+                    out += entry->name + "_bucket" + label_set(entry->labels, "le=\"" + le + "\"") + " " +
+                           std::to_string(cumulative) + "\n";
+                }
+                out += entry->name + "_sum" + label_set(entry->labels) + " " +
+                       format_number(static_cast<double>(histogram.get_sum()) * scale) + "\n";
+                // 以桶累计值作为count，保证与+Inf桶一致
+                out += entry->name + "_count" + label_set(entry->labels) + " " +
+                       std::to_string(cumulative) + "\n";
+                break;
+            }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,86 @@
+#include "../include/utils/rate_limiter.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+uint64_t mix(uint64_t key) {
+    // splitmix64终结函数，打散连续的用户ID
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
+
+size_t round_up_pow2(size_t value) {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+} // namespace
+
+RateLimiter::Limits RateLimiter::Limits::from_env(const char* prefix, Limits defaults) {
+    Limits limits = defaults;
+
+    if (const char* burst = std::getenv((std::string(prefix) + "_BURST").c_str())) {
+        long value = std::strtol(burst, nullptr, 10);
+        if (value > 0) limits.burst = static_cast<uint32_t>(value);
+    }
+    if (const char* rate = std::getenv((std::string(prefix) + "_RATE").c_str())) {
+        double value = std::strtod(rate, nullptr);
+        if (value > 0) limits.refill_per_second = value;
+    }
+
+    return limits;
+}
+
+RateLimiter::RateLimiter(Limits limits, size_t bucket_count)
+    : capacity(std::min<uint64_t>(std::max<uint32_t>(limits.burst, 1) * TOKEN_UNIT, DEFICIT_MASK)),
+      refill_per_ms(limits.refill_per_second * TOKEN_UNIT / 1000.0),
+      epoch(Clock::now()),
+      mask(round_up_pow2(std::max<size_t>(bucket_count, 1)) - 1),
+      buckets(new std::atomic<uint64_t>[mask + 1]) {
+    for (size_t i = 0; i <= mask; ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+bool RateLimiter::try_acquire(uint64_t key) {
+    std::atomic<uint64_t>& bucket = buckets[mix(key) & mask];
+    uint64_t now = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - epoch).count());
+
+    uint64_t state = bucket.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t last = state >> TIME_SHIFT;
+        uint64_t deficit = state & DEFICIT_MASK;
+
+        // 按经过的时间补充令牌；不足一个单位时保留原时间戳，避免零头被丢弃
+        if (now > last && deficit > 0) {
+            double refill = static_cast<double>(now - last) * refill_per_ms;
+            if (refill >= static_cast<double>(deficit)) {
+                deficit = 0;
+                last = now;
+            } else if (refill >= 1.0) {
+                deficit -= static_cast<uint64_t>(refill);
+                last = now;
+            }
+        } else if (deficit == 0) {
+            last = now;
+        }
+
+        if (deficit + TOKEN_UNIT > capacity) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        uint64_t next = (last << TIME_SHIFT) | (deficit + TOKEN_UNIT);
+        if (bucket.compare_exchange_weak(state, next, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,137 @@
+// 回归测试：二进制协议中的非法UTF-8字符串必须在解码时被拒绝，不能落盘或进入房间缓冲区
+// 用法：binary_utf8_test（失败时返回非0，由ctest运行）
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+#include "database/database_manager.h"
+#include "handlers/binary_codec.h"
+#include "handlers/websocket_handler.h"
+#include "models/user.h"
+#include "services/auth_service.h"
+#include "services/chat_service.h"
+#include "utils/logger.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+// 不连接网络的连接桩
+class FakeConnection : public crow::websocket::connection {
+public:
+    void send_binary(std::string) override {}
+    void send_text(std::string) override {}
+    void send_ping(std::string) override {}
+    void send_pong(std::string) override {}
+    void close(std::string const&, uint16_t) override {}
+    std::string get_remote_ip() override { return "127.0.0.1"; }
+    std::string get_subprotocol() const override { return ""; }
+};
+
+std::string auth_frame(const std::string& token) {
+    std::string out(1, static_cast<char>(BinaryCodec::OP_AUTH));
+    BinaryCodec::put_string(out, token);
+    return out;
+}
+
+std::string chat_frame(const std::string& content, const std::string& room = "") {
+    std::string out(1, static_cast<char>(BinaryCodec::OP_CHAT));
+    BinaryCodec::put_string(out, content);
+    if (!room.empty()) BinaryCodec::put_string(out, room);
+    return out;
+}
+
+std::string join_frame(const std::string& room) {
+    std::string out(1, static_cast<char>(BinaryCodec::OP_JOIN_ROOM));
+    BinaryCodec::put_string(out, room);
+    return out;
+}
+
+void test_decode() {
+    InboundMessage msg;
+    check(!BinaryCodec::decode(chat_frame("bad\xff\xfe"), msg), "invalid content rejected");
+    check(!BinaryCodec::decode(chat_frame("ok", "room\xc0\xaf"), msg), "overlong room encoding rejected");
+    check(!BinaryCodec::decode(chat_frame("\xed\xa0\x80"), msg), "surrogate rejected");
+    check(!BinaryCodec::decode(auth_frame("tok\xe4\xb8"), msg), "truncated token rejected");
+    check(!BinaryCodec::decode(join_frame("\x80"), msg), "lone continuation byte rejected");
+
+    // 字符串字段是帧数据的视图，帧必须比解码结果活得久
+    std::string frame = chat_frame("你好 \xf0\x9f\x98\x80", "general");
+    InboundMessage valid;
+    check(BinaryCodec::decode(frame, valid), "valid UTF-8 accepted");
+    check(valid.content == "你好 \xf0\x9f\x98\x80", "valid content preserved");
+}
+
+} // namespace
+
+int main() {
+    test_decode();
+
+    std::string db_path = (std::filesystem::temp_directory_path() /
+                           ("chatroom_utf8_test_" + std::to_string(getpid()) + ".db")).string();
+    {
+        auto db = std::make_shared<DatabaseManager>(db_path);
+        if (!db->initialize()) {
+            std::fprintf(stderr, "Failed to initialize test database at %s\n", db_path.c_str());
+            return 1;
+        }
+
+        User alice_user(0, "alice", "x", "alice@example.com");
+        db->create_user(alice_user);
+        auto alice = db->get_user_by_username("alice");
+        if (!alice) {
+            std::fprintf(stderr, "Failed to create test user\n");
+            return 1;
+        }
+
+        auto auth_service = std::make_shared<AuthService>(db);
+        auto chat_service = std::make_shared<ChatService>(db);
+        WebSocketHandler handler(chat_service, auth_service);
+
+        // 非法UTF-8的聊天帧被丢弃，不抛出异常也不写入房间
+        FakeConnection conn;
+        handler.on_open(conn);
+        handler.on_message(conn, auth_frame(auth_service->generate_token(*alice)), true);
+        handler.on_message(conn, chat_frame("bad\xff\xfe"), true);
+        handler.on_message(conn, chat_frame("hello"), true);
+
+        auto page = chat_service->get_chat_history_page(alice->id, Message::DEFAULT_ROOM, 0, 0);
+        check(page.messages.size() == 1, "only the valid message is stored");
+        bool serializable = true;
+        try {
+            nlohmann::json history = nlohmann::json::array();
+            for (const auto& message : page.messages) {
+                history.push_back(message.to_json());
+            }
+            history.dump();
+        } catch (const std::exception&) {
+            serializable = false;
+        }
+        check(serializable, "room history still serializes");
+
+        handler.on_close(conn, "test");
+    }
+
+    Logger::flush();
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::error_code ec;
+        std::filesystem::remove(db_path + suffix, ec);
+    }
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("binary_utf8_test: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+// 敏感词自动机与过滤替换测试：重叠、嵌套命中必须整体屏蔽
+// 用法：message_filter_test（失败时返回非0，由ctest运行）
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "services/message_filter.h"
+#include "utils/aho_corasick.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+void check_equal(const std::string& actual, const std::string& expected, const std::string& what) {
+    if (actual != expected) {
+        std::fprintf(stderr, "FAILED: %s: expected \"%s\", got \"%s\"\n",
+                     what.c_str(), expected.c_str(), actual.c_str());
+        ++failures;
+    }
+}
+
+AhoCorasick build(const std::vector<std::string>& patterns) {
+    AhoCorasick matcher;
+    for (const auto& pattern : patterns) {
+        matcher.add_pattern(pattern);
+    }
+    matcher.build();
+    return matcher;
+}
+
+void test_automaton() {
+    // 嵌套：较短的词是较长词的后缀或中段，两者都要报告
+    auto matcher = build({"bc", "abcd", "c"});
+    auto matches = matcher.find_all("xabcdx");
+    check(matches.size() == 3, "find_all reports nested hits");
+    if (matches.size() == 3) {
+        check(matches[0].start == 2 && matches[0].length == 2, "first hit is bc");
+        check(matches[1].start == 3 && matches[1].length == 1, "second hit is c");
+        check(matches[2].start == 1 && matches[2].length == 4, "third hit is abcd");
+    }
+    check(matcher.count_matches("xabcdx") == 3, "count_matches counts nested hits");
+
+    // 输出链接跨越非模式节点
+    auto suffixes = build({"she", "he", "hers"});
+    check(suffixes.find_all("ushers").size() == 3, "find_all follows output links");
+
+    // ASCII大小写不敏感
+    check(build({"damn"}).contains_any("DaMn it"), "matching folds ASCII case");
+
+    // 多字节字符：不报告截断字符的命中
+    auto cjk = build({"\xe5\x9e"});
+    check(cjk.find_all("垃圾").empty(), "hits splitting a UTF-8 character are dropped");
+    check(build({"垃圾"}).find_all("这是垃圾").size() == 1, "CJK hit found");
+
+    check(build({}).find_all("anything").empty(), "empty automaton matches nothing");
+}
+
+void test_replacement() {
+    // 不存在的词库文件：只有默认词和下面添加的词
+    MessageFilter filter("nonexistent_sensitive_words.txt");
+    filter.stop_watching();
+    for (const char* word : {"goddamnit", "bc", "abcd", "ab", "cde", "坏蛋", "大坏蛋"}) {
+        filter.add_sensitive_word(word);
+    }
+
+    // 较长的词起始于已命中的较短词之前（默认词含"damn"）
+    check_equal(filter.filter_message("goddamnit"), "*********", "longer word around a shorter one");
+    check_equal(filter.filter_message("xabcdx"), "x****x", "word containing a shorter word");
+    // 部分重叠的命中合并为一个区间
+    check_equal(filter.filter_message("xabcdex"), "x*****x", "overlapping words merge");
+    check_equal(filter.filter_message("ab ab"), "** **", "disjoint hits stay separate");
+    // 按字符而不是字节屏蔽
+    check_equal(filter.filter_message("你是大坏蛋吗"), "你是***吗", "nested CJK words");
+    check_equal(filter.filter_message("nothing to see"), "nothing to see", "clean text unchanged");
+    check_equal(filter.filter_message(""), "", "empty text");
+}
+
+} // namespace
+
+int main() {
+    test_automaton();
+    test_replacement();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("message_filter_test: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,134 @@
+// 回归测试：同一WebSocket连接重复认证或切换身份后，关闭连接时用户必须离线
+// 用法：websocket_reauth_test（失败时返回非0，由ctest运行）
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include "database/database_manager.h"
+#include "handlers/websocket_handler.h"
+#include "models/user.h"
+#include "services/auth_service.h"
+#include "services/chat_service.h"
+#include "utils/logger.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+// 不连接网络的连接桩，只记录是否被关闭
+class FakeConnection : public crow::websocket::connection {
+public:
+    bool closed = false;
+
+    void send_binary(std::string) override {}
+    void send_text(std::string) override {}
+    void send_ping(std::string) override {}
+    void send_pong(std::string) override {}
+    void close(std::string const&, uint16_t) override { closed = true; }
+    std::string get_remote_ip() override { return "127.0.0.1"; }
+    std::string get_subprotocol() const override { return ""; }
+};
+
+bool is_online(ChatService& chat_service, int user_id) {
+    for (const auto& user : chat_service.get_online_users_list()) {
+        if (user.id == user_id) return true;
+    }
+    return false;
+}
+
+std::string auth_frame(const std::string& token) {
+    return "{\"type\":\"auth\",\"token\":\"" + token + "\"}";
+}
+
+} // namespace
+
+int main() {
+    std::string db_path = (std::filesystem::temp_directory_path() /
+                           ("chatroom_reauth_test_" + std::to_string(getpid()) + ".db")).string();
+    {
+        auto db = std::make_shared<DatabaseManager>(db_path);
+        if (!db->initialize()) {
+            std::fprintf(stderr, "Failed to initialize test database at %s\n", db_path.c_str());
+            return 1;
+        }
+
+        User alice_user(0, "alice", "x", "alice@example.com");
+        User bob_user(0, "bob", "x", "bob@example.com");
+        db->create_user(alice_user);
+        db->create_user(bob_user);
+        auto alice = db->get_user_by_username("alice");
+        auto bob = db->get_user_by_username("bob");
+        if (!alice || !bob) {
+            std::fprintf(stderr, "Failed to create test users\n");
+            return 1;
+        }
+
+        auto auth_service = std::make_shared<AuthService>(db);
+        auto chat_service = std::make_shared<ChatService>(db);
+        WebSocketHandler handler(chat_service, auth_service);
+        std::string alice_token = auth_service->generate_token(*alice);
+        std::string bob_token = auth_service->generate_token(*bob);
+
+        // 同一连接以同一用户认证两次，关闭后应离线
+        {
+            FakeConnection conn;
+            handler.on_open(conn);
+            handler.on_message(conn, auth_frame(alice_token), false);
+            handler.on_message(conn, auth_frame(alice_token), false);
+            check(is_online(*chat_service, alice->id), "alice online after repeated auth");
+            handler.on_close(conn, "test");
+            check(!is_online(*chat_service, alice->id), "alice offline after closing re-authenticated socket");
+        }
+
+        // 同一连接切换身份，旧身份立即离线，关闭后新身份也离线
+        {
+            FakeConnection conn;
+            handler.on_open(conn);
+            handler.on_message(conn, auth_frame(alice_token), false);
+            handler.on_message(conn, auth_frame(bob_token), false);
+            check(!is_online(*chat_service, alice->id), "alice offline after socket switched to bob");
+            check(is_online(*chat_service, bob->id), "bob online after switching identity");
+            handler.on_close(conn, "test");
+            check(!is_online(*chat_service, bob->id), "bob offline after closing switched socket");
+        }
+
+        // 同一用户的其他连接仍在线时，重复认证的连接关闭不影响在线状态
+        {
+            FakeConnection first;
+            FakeConnection second;
+            handler.on_open(first);
+            handler.on_open(second);
+            handler.on_message(first, auth_frame(alice_token), false);
+            handler.on_message(second, auth_frame(alice_token), false);
+            handler.on_message(second, auth_frame(alice_token), false);
+            handler.on_close(second, "test");
+            check(is_online(*chat_service, alice->id), "alice online while another socket remains");
+            handler.on_close(first, "test");
+            check(!is_online(*chat_service, alice->id), "alice offline after last socket closes");
+        }
+
+        check(chat_service->get_online_count() == 0, "no users left online");
+    }
+
+    Logger::flush();
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::error_code ec;
+        std::filesystem::remove(db_path + suffix, ec);
+    }
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("websocket_reauth_test: all checks passed\n");
+    return 0;
+}